@@ -0,0 +1,142 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Text rendering microbenchmark: measures drw_fontset_getwidth, drw_text
+ * and drw_font_getexts with the fonts of config.h on an Xvfb server, for
+ * the kinds of strings the bar draws. drawstatusbar takes the place of
+ * drw_text for status2d strings. Reports calls per second, Xft extents
+ * calls per string and fallback fonts loaded.
+ */
+#define main    dwmmain
+#include "../dwm.c"
+#undef main
+
+#include "harness.h"
+
+enum { OpWidth, OpText, OpExts, OpStatus };
+
+static const char *opnames[] = { "getwidth", "text", "getexts", "status" };
+
+static const struct {
+    const char *name;
+    const char *text;
+} inputs[] = {
+    { "tag label",   NULL }, /* tags[0] */
+    { "long title",  "Performance engineering notes - a very long page title that will never "
+                     "fit in the bar - Mozilla Firefox (Private Browsing)" },
+    { "nerd icons",  "\xef\x84\xa0 \xef\x89\xa9 \xef\x81\xbb \xef\x80\x81 \xef\x87\xbc" },
+    { "cjk",         "\xe6\x96\x87\xe4\xbb\xb6\xe7\xae\xa1\xe7\x90\x86\xe5\x99\xa8 - "
+                     "\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88" },
+    { "emoji",       "build \xe2\x9c\x85 deploy \xf0\x9f\x9a\x80 alerts \xf0\x9f\x94\xa5" },
+    { "status2d",    "^c#5fafff^\xef\x8b\x9b 12%^d^ ^r0,4,6,6^^f8^^c#ff5f5f^MEM 2.1G^d^ "
+                     "^b#1e1c31^VOL 40%^d^ Mon 19 Oct 14:02" },
+};
+
+static unsigned long long budget = 200000000ULL; /* ns per input and op */
+
+static void
+usage(void)
+{
+    die("usage: drwbench [-x server] [-t ms] [-w width]");
+}
+
+static void
+call(int op, const char *s, int w)
+{
+    unsigned int ew;
+
+    switch (op) {
+    case OpWidth:
+        drw_fontset_getwidth(drw, s);
+        break;
+    case OpText:
+        drw_text(drw, 0, 0, w, bh, lrpad / 2, s, 0);
+        break;
+    case OpExts:
+        drw_font_getexts(drw->fonts, s, strlen(s), &ew, NULL);
+        break;
+    case OpStatus:
+        drawstatusbar(selmon, bh, (char *)s);
+        break;
+    }
+}
+
+static void
+run1(const char *name, int op, const char *s, int w)
+{
+    unsigned long long t, start;
+    unsigned long calls = 0, exts, loads, firstloads, i;
+
+    drw_setscheme(drw, scheme[SchemeNorm]);
+    /* the first call pays for fallback font matching, count it on its own */
+    loads = fontloads;
+    call(op, s, w);
+    firstloads = fontloads - loads;
+
+    exts = xftextents;
+    loads = fontloads;
+    start = prof_now();
+    do {
+        for (i = 0; i < 64; i++)
+            call(op, s, w);
+        calls += i;
+    } while ((t = prof_now() - start) < budget);
+    XSync(dpy, False);
+    t = prof_now() - start;
+
+    printf("%-12s %-9s %9lu %12.0f %10.1f %6lu %6lu\n", name, opnames[op], calls,
+        calls / (t / 1e9), (double)(xftextents - exts) / calls, firstloads,
+        fontloads - loads);
+}
+
+int
+main(int argc, char *argv[])
+{
+    Harness h;
+    Fnt *f;
+    const char *server = "Xvfb", *s;
+    int i, n, w = 300;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 == argc)
+            usage();
+        else if (!strcmp(argv[i], "-x"))
+            server = argv[++i];
+        else if (!strcmp(argv[i], "-t"))
+            budget = strtoull(argv[++i], NULL, 10) * 1000000ULL;
+        else if (!strcmp(argv[i], "-w"))
+            w = atoi(argv[++i]);
+        else
+            usage();
+    }
+    if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
+        fputs("warning: no locale support\n", stderr);
+    if (!harness_display(&h, server, 1920, 1080)) {
+        harness_stop(&h);
+        die("drwbench: cannot start %s", server);
+    }
+    dpy = h.dpy;
+    if (!(xcon = XGetXCBConnection(dpy)))
+        die("drwbench: cannot get xcb connection");
+    setup();
+
+    printf("font '%s', bar height %d, text width %d\n", fonts[0], bh, w);
+    printf("%-12s %-9s %9s %12s %10s %6s %6s\n", "input", "op", "calls", "calls/s",
+        "exts/call", "first", "loads");
+    for (i = 0; i < LENGTH(inputs); i++) {
+        s = inputs[i].text ? inputs[i].text : tags[0];
+        if (!strcmp(inputs[i].name, "status2d")) {
+            run1(inputs[i].name, OpStatus, s, w);
+            continue;
+        }
+        run1(inputs[i].name, OpWidth, s, w);
+        run1(inputs[i].name, OpText, s, w);
+        run1(inputs[i].name, OpExts, s, w);
+    }
+    /* drw_text appends every fallback it loads to the fontset */
+    for (n = 0, f = drw->fonts; f; f = f->next, n++);
+    printf("fonts in set: %d configured, %d after fallback\n", (int)LENGTH(fonts), n);
+
+    cleanup();
+    harness_stop(&h);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,305 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Shared pieces of the X benchmarks: an Xvfb (or Xephyr) server unless
+ * DISPLAY is set, the window manager under test with its stderr captured,
+ * synthetic clients and the fake signal IPC that dwmc uses. Every fake
+ * signal is acknowledged by dwm on the _DWM_FSIGNAL root property, which
+ * gives the end-to-end latency of a command.
+ */
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "harness.h"
+#include "../util.h"
+
+static int
+spawnserver(Harness *h, const char *server, int w, int ht)
+{
+    char disp[16], geom[32];
+    int n;
+
+    for (n = 90; n < 200; n++) {
+        snprintf(disp, sizeof disp, "/tmp/.X%d-lock", n);
+        if (access(disp, F_OK))
+            break;
+    }
+    snprintf(disp, sizeof disp, ":%d", n);
+    if ((h->xserver = fork()) == 0) {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        if (strstr(server, "Xephyr")) {
+            snprintf(geom, sizeof geom, "%dx%d", w, ht);
+            execlp(server, server, disp, "-screen", geom, "-ac", (char *)NULL);
+        } else {
+            snprintf(geom, sizeof geom, "%dx%dx24", w, ht);
+            execlp(server, server, disp, "-screen", "0", geom, "-nolisten", "tcp", (char *)NULL);
+        }
+        _exit(127);
+    }
+    if (h->xserver < 0)
+        return 0;
+    setenv("DISPLAY", disp, 1);
+    return 1;
+}
+
+static int
+wmrunning(Harness *h)
+{
+    Atom check = XInternAtom(h->dpy, "_NET_SUPPORTING_WM_CHECK", False), da;
+    unsigned char *p = NULL;
+    unsigned long n, extra;
+    int di;
+
+    if (XGetWindowProperty(h->dpy, h->root, check, 0, 1, False, XA_WINDOW,
+        &da, &di, &n, &extra, &p) != Success || !p)
+        return 0;
+    XFree(p);
+    return n > 0;
+}
+
+/* connects to DISPLAY or a fresh server, without a window manager */
+int
+harness_display(Harness *h, const char *server, int w, int ht)
+{
+    int i;
+
+    memset(h, 0, sizeof *h);
+    if ((!getenv("DISPLAY") || !*getenv("DISPLAY")) && !spawnserver(h, server, w, ht))
+        return 0;
+    for (i = 0; i < 500 && !(h->dpy = XOpenDisplay(NULL)); i++)
+        usleep(10000);
+    if (!h->dpy)
+        return 0;
+    h->root = DefaultRootWindow(h->dpy);
+    h->fsignal = XInternAtom(h->dpy, "_DWM_FSIGNAL", False);
+    h->wmstate = XInternAtom(h->dpy, "WM_STATE", False);
+    h->tag = XInternAtom(h->dpy, "_TAG", False);
+    h->activewin = XInternAtom(h->dpy, "_NET_ACTIVE_WINDOW", False);
+    h->curdesktop = XInternAtom(h->dpy, "_NET_CURRENT_DESKTOP", False);
+    return 1;
+}
+
+int
+harness_start(Harness *h, const char *server, const char *wm, int w, int ht)
+{
+    int i, fd;
+
+    if (!harness_display(h, server, w, ht))
+        return 0;
+    strcpy(h->errfile, "/tmp/dwmbench.XXXXXX");
+    if ((fd = mkstemp(h->errfile)) < 0)
+        return 0;
+    if ((h->wm = fork()) == 0) {
+        dup2(fd, 2);
+        execl(wm, wm, (char *)NULL);
+        _exit(127);
+    }
+    close(fd);
+    for (i = 0; i < 500 && !wmrunning(h); i++) {
+        if (waitpid(h->wm, NULL, WNOHANG) == h->wm) {
+            h->wm = 0;
+            return 0;
+        }
+        usleep(10000);
+    }
+    XSelectInput(h->dpy, h->root, PropertyChangeMask);
+    return wmrunning(h);
+}
+
+void
+harness_stop(Harness *h)
+{
+    if (h->dpy)
+        XCloseDisplay(h->dpy);
+    if (h->wm > 0) {
+        kill(h->wm, SIGTERM);
+        waitpid(h->wm, NULL, 0);
+    }
+    if (h->xserver > 0) {
+        kill(h->xserver, SIGTERM);
+        waitpid(h->xserver, NULL, 0);
+    }
+    if (h->errfile[0])
+        unlink(h->errfile);
+}
+
+/* returns 0 once timeout ms pass without an event */
+int
+harness_next(Harness *h, XEvent *ev, int timeout)
+{
+    struct pollfd pfd = { ConnectionNumber(h->dpy), POLLIN, 0 };
+
+    while (!XPending(h->dpy))
+        if (poll(&pfd, 1, timeout) <= 0)
+            return 0;
+    XNextEvent(h->dpy, ev);
+    return 1;
+}
+
+/* sends cmd like dwmc does and waits until dwm has handled it */
+unsigned long long
+harness_fsignal(Harness *h, const char *cmd)
+{
+    char buf[256];
+    unsigned long long t;
+    XEvent ev;
+
+    snprintf(buf, sizeof buf, "fsignal:%s", cmd);
+    t = now();
+    XStoreName(h->dpy, h->root, buf);
+    XFlush(h->dpy);
+    while (harness_next(h, &ev, 5000))
+        if (ev.type == PropertyNotify && ev.xproperty.window == h->root
+        && ev.xproperty.atom == h->fsignal)
+            return now() - t;
+    die("bench: no acknowledgement for '%s'", cmd);
+    return 0;
+}
+
+static long
+getwmstate(Harness *h, Window w)
+{
+    unsigned char *p = NULL;
+    unsigned long n, extra;
+    long state = -1;
+    Atom real;
+    int format;
+
+    if (XGetWindowProperty(h->dpy, w, h->wmstate, 0, 2, False, h->wmstate,
+        &real, &format, &n, &extra, &p) != Success || !p)
+        return -1;
+    if (n)
+        state = *(long *)p;
+    XFree(p);
+    return state;
+}
+
+/* waits for n clients to be put into state, returns how many were */
+size_t
+harness_waitstate(Harness *h, size_t n, long state)
+{
+    size_t seen = 0;
+    XEvent ev;
+
+    while (seen < n && harness_next(h, &ev, 5000))
+        if (ev.type == PropertyNotify && ev.xproperty.atom == h->wmstate
+        && ev.xproperty.state == PropertyNewValue
+        && getwmstate(h, ev.xproperty.window) == state)
+            seen++;
+    return seen;
+}
+
+/* hints: 0 none, 1 minimum size, 2 also terminal-like increments */
+Window
+harness_client(Harness *h, const char *class, const char *title, unsigned int tags, Window transient, int hints)
+{
+    XSetWindowAttributes wa = { .event_mask = StructureNotifyMask|PropertyChangeMask };
+    XClassHint ch = { (char *)class, (char *)class };
+    XSizeHints sh = { 0 };
+    long data = tags;
+    Window w;
+
+    w = XCreateWindow(h->dpy, h->root, 0, 0, 640, 480, 0, CopyFromParent,
+        InputOutput, CopyFromParent, CWEventMask, &wa);
+    XSetClassHint(h->dpy, w, &ch);
+    XStoreName(h->dpy, w, title);
+    if (tags)
+        XChangeProperty(h->dpy, w, h->tag, XA_CARDINAL, 32, PropModeReplace,
+            (unsigned char *)&data, 1);
+    if (transient)
+        XSetTransientForHint(h->dpy, w, transient);
+    if (hints) {
+        sh.flags = PMinSize;
+        sh.min_width = 100;
+        sh.min_height = 50;
+        if (hints > 1) {
+            sh.flags |= PResizeInc|PBaseSize;
+            sh.width_inc = 7;
+            sh.height_inc = 13;
+            sh.base_width = sh.base_height = 2;
+        }
+        XSetWMNormalHints(h->dpy, w, &sh);
+    }
+    return w;
+}
+
+/* reads one entry of dwm's JSON profile dump (dwmc dumpprofile 1) */
+int
+harness_profile(Harness *h, const char *name, unsigned long *count,
+    unsigned long long *total, unsigned long long *max)
+{
+    char key[64], *buf, *p, *last = NULL;
+    FILE *f;
+    long len;
+
+    harness_fsignal(h, "dumpprofile i 1");
+    if (!(f = fopen(h->errfile, "r")))
+        return 0;
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    rewind(f);
+    buf = ecalloc(len + 1, 1);
+    len = fread(buf, 1, len, f);
+    fclose(f);
+
+    snprintf(key, sizeof key, "{\"name\":\"%s\",", name);
+    for (p = buf; (p = strstr(p, key)); p++)
+        last = p;
+    if (last)
+        last = sscanf(last + strlen(key), "\"count\":%lu,\"total_ns\":%llu,\"max_ns\":%llu",
+            count, total, max) == 3 ? last : NULL;
+    free(buf);
+    return last != NULL;
+}
+
+unsigned long long
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+samples_add(Samples *s, unsigned long long ns)
+{
+    if (s->n == s->size) {
+        s->size = s->size ? s->size * 2 : 256;
+        if (!(s->v = realloc(s->v, s->size * sizeof *s->v)))
+            die("realloc:");
+    }
+    s->v[s->n++] = ns;
+}
+
+static int
+cmpull(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+unsigned long long
+samples_pct(Samples *s, unsigned int p)
+{
+    if (!s->n)
+        return 0;
+    qsort(s->v, s->n, sizeof *s->v, cmpull);
+    return s->v[(s->n - 1) * p / 100];
+}
+
+void
+samples_clear(Samples *s)
+{
+    s->n = 0;
+}
@@ -0,0 +1,36 @@
+/* See LICENSE file for copyright and license details. */
+
+typedef struct {
+    Display *dpy;
+    Window root;
+    pid_t xserver, wm;
+    char errfile[32];    /* stderr of the window manager */
+    Atom fsignal, wmstate, tag, activewin, curdesktop;
+} Harness;
+
+typedef struct {
+    unsigned long long *v;
+    size_t n, size;
+} Samples;
+
+/* Harness */
+int harness_display(Harness *h, const char *server, int w, int ht);
+int harness_start(Harness *h, const char *server, const char *wm, int w, int ht);
+void harness_stop(Harness *h);
+
+/* Events */
+int harness_next(Harness *h, XEvent *ev, int timeout);
+unsigned long long harness_fsignal(Harness *h, const char *cmd);
+size_t harness_waitstate(Harness *h, size_t n, long state);
+
+/* Clients */
+Window harness_client(Harness *h, const char *class, const char *title, unsigned int tags, Window transient, int hints);
+
+/* Profile dump of the window manager */
+int harness_profile(Harness *h, const char *name, unsigned long *count, unsigned long long *total, unsigned long long *max);
+
+/* Samples */
+unsigned long long now(void);
+void samples_add(Samples *s, unsigned long long ns);
+unsigned long long samples_pct(Samples *s, unsigned int p);
+void samples_clear(Samples *s);
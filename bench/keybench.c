@@ -0,0 +1,200 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Input-to-effect latency benchmark: injects the view and focusstack
+ * keychords of config.h with XTEST and times how long the window manager
+ * takes to make the effect visible, with 1, 50 and 500 managed clients.
+ * The effect is first seen as a _NET_CURRENT_DESKTOP or _NET_ACTIVE_WINDOW
+ * change on the root window and is settled with the last ConfigureNotify
+ * on the clients before a fake signal fence. Exits 1 when a p99 is above
+ * its threshold or a keypress showed no effect within a second.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+#include "harness.h"
+#include "../util.h"
+
+/* p99 thresholds of the settled latency in us, override with -v and -f */
+#define VIEWP99      20000
+#define FOCUSP99     10000
+
+#define LENGTH(X)    (sizeof X / sizeof X[0])
+
+typedef struct {
+    const char *name;
+    KeySym mod, key[2]; /* alternated between samples */
+    Atom *effect;
+    unsigned long long max; /* threshold in ns */
+    Samples first, settled;
+} Workload;
+
+static Harness h;
+static Window *wins;
+static int nwins;
+
+static void
+usage(void)
+{
+    die("usage: keybench [-r rounds] [-v view-p99-us] [-f focus-p99-us] [-x server] [wm]");
+}
+
+static void
+presskey(KeySym mod, KeySym key)
+{
+    KeyCode m = XKeysymToKeycode(h.dpy, mod), k = XKeysymToKeycode(h.dpy, key);
+
+    XTestFakeKeyEvent(h.dpy, m, True, CurrentTime);
+    XTestFakeKeyEvent(h.dpy, k, True, CurrentTime);
+    XTestFakeKeyEvent(h.dpy, k, False, CurrentTime);
+    XTestFakeKeyEvent(h.dpy, m, False, CurrentTime);
+    XFlush(h.dpy);
+}
+
+/* the fence is acknowledged after everything the keypress caused, returns
+ * whether the effect showed before it */
+static int
+fence(Workload *w, unsigned long long *last)
+{
+    XEvent ev;
+    int seen = 0;
+
+    XStoreName(h.dpy, h.root, "fsignal:sync");
+    XFlush(h.dpy);
+    while (harness_next(&h, &ev, 5000)) {
+        if (ev.type == ConfigureNotify)
+            *last = now();
+        else if (ev.type == PropertyNotify && ev.xproperty.window == h.root
+        && ev.xproperty.atom == *w->effect)
+            seen = 1;
+        else if (ev.type == PropertyNotify && ev.xproperty.window == h.root
+        && ev.xproperty.atom == h.fsignal)
+            break;
+    }
+    return seen;
+}
+
+/* returns 1 for a sample, 0 if the effect came after more than a second
+ * and -1 if it did not come at all */
+static int
+measure(Workload *w, KeySym key)
+{
+    unsigned long long t, first = 0, last = 0;
+    XEvent ev;
+
+    t = now();
+    presskey(w->mod, key);
+    while (!first && harness_next(&h, &ev, 1000)) {
+        if (ev.type == ConfigureNotify)
+            last = now();
+        else if (ev.type == PropertyNotify && ev.xproperty.window == h.root
+        && ev.xproperty.atom == *w->effect)
+            first = now();
+    }
+    if (!first)
+        return fence(w, &last) ? 0 : -1;
+    fence(w, &last);
+    samples_add(&w->first, first - t);
+    samples_add(&w->settled, (last > first ? last : first) - t);
+    return 1;
+}
+
+/* a missed keypress fails the workload like a slow one */
+static int
+report(Workload *w, int n, int missed)
+{
+    unsigned long long p99 = samples_pct(&w->settled, 99);
+    int ok = p99 <= w->max && !missed && w->settled.n;
+    char note[32] = "";
+
+    if (missed)
+        snprintf(note, sizeof note, " (%d missed)", missed);
+    printf("%-12s %6d %8zu %10.1f %10.1f %10.1f %10.1f %10.1f%s%s\n", w->name, n, w->settled.n,
+        samples_pct(&w->first, 50) / 1e3, samples_pct(&w->first, 99) / 1e3,
+        samples_pct(&w->settled, 50) / 1e3, p99 / 1e3,
+        w->settled.n ? w->settled.v[w->settled.n - 1] / 1e3 : 0,
+        ok ? "" : "  REGRESSED", note);
+    samples_clear(&w->first);
+    samples_clear(&w->settled);
+    return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int counts[] = { 1, 50, 500 };
+    const char *server = "Xvfb", *wm = "./dwm";
+    Workload wl[] = {
+        { "view", XK_Alt_L, { XK_2, XK_1 }, &h.curdesktop, VIEWP99 * 1000ULL },
+        { "focusstack", XK_Alt_L, { XK_k, XK_j }, &h.activewin, FOCUSP99 * 1000ULL },
+    };
+    int i, j, k, r, m, rounds = 100, ok = 1, missed;
+    char title[32];
+
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            wm = argv[i];
+            continue;
+        }
+        if (i + 1 == argc)
+            usage();
+        else if (!strcmp(argv[i], "-r"))
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))
+            wl[0].max = strtoull(argv[++i], NULL, 10) * 1000;
+        else if (!strcmp(argv[i], "-f"))
+            wl[1].max = strtoull(argv[++i], NULL, 10) * 1000;
+        else if (!strcmp(argv[i], "-x"))
+            server = argv[++i];
+        else
+            usage();
+    }
+    if (rounds < 2)
+        usage();
+    rounds += rounds % 2; /* so every workload ends on the first tag */
+    if (!harness_start(&h, server, wm, 1920, 1080))
+        die("keybench: cannot start %s under %s", wm, server);
+    if (!XTestQueryExtension(h.dpy, &i, &i, &i, &i))
+        die("keybench: no XTEST on %s", DisplayString(h.dpy));
+    wins = ecalloc(counts[LENGTH(counts) - 1], sizeof *wins);
+
+    printf("%-12s %6s %8s %10s %10s %10s %10s %10s\n", "workload", "wins", "samples",
+        "p50(us)", "p99(us)", "settled50", "settled99", "max(us)");
+    for (i = 0; i < LENGTH(counts); i++) {
+        /* clients alternate between the first two tags, so a view
+         * hides one half and shows the other */
+        for (j = nwins; j < counts[i]; j++) {
+            snprintf(title, sizeof title, "keybench %d", j);
+            wins[j] = harness_client(&h, "keybench", title, 1 << (j % 2), None, 0);
+            XMapWindow(h.dpy, wins[j]);
+        }
+        XFlush(h.dpy);
+        if (harness_waitstate(&h, counts[i] - nwins, NormalState) < (size_t)(counts[i] - nwins))
+            die("keybench: clients were not managed");
+        nwins = counts[i];
+
+        for (j = 0; j < LENGTH(wl); j++) {
+            /* a keypress without effect is repeated, so the keys stay in
+             * step with the tags and the workload ends on the first one */
+            for (r = k = missed = 0; k < rounds && r < 2 * rounds; r++) {
+                m = measure(&wl[j], wl[j].key[k % 2]);
+                missed += m <= 0;
+                k += m >= 0;
+            }
+            if (missed)
+                fprintf(stderr, "keybench: %s showed no effect within a second %d times\n",
+                    wl[j].name, missed);
+            k = report(&wl[j], nwins, missed);
+            ok = ok && k;
+        }
+    }
+
+    harness_stop(&h);
+    free(wins);
+    return !ok;
+}
@@ -0,0 +1,148 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Layout microbenchmark: runs the arrange functions of vanitygaps.c and
+ * monocle over a synthetic monitor with 1 to 1000 tiled clients, with the
+ * X requests going to the stubs in xstub.c. Reports ns and X requests per
+ * arrange and how many clients end up outside the window area.
+ */
+#define main    dwmmain
+#include "../dwm.c"
+#undef main
+
+static const struct {
+    const char *name;
+    void (*arrange)(Monitor *);
+} bench[] = {
+    { "tile",                   tile },
+    { "bstack",                 bstack },
+    { "bstackhoriz",            bstackhoriz },
+    { "centeredmaster",         centeredmaster },
+    { "centeredfloatingmaster", centeredfloatingmaster },
+    { "deck",                   deck },
+    { "spiral",                 spiral },
+    { "dwindle",                dwindle },
+    { "gaplessgrid",            gaplessgrid },
+    { "nrowgrid",               nrowgrid },
+    { "monocle",                monocle },
+};
+
+static const int counts[] = { 1, 2, 3, 5, 10, 20, 50, 100, 200, 500, 1000 };
+static int varycfacts = 0;
+
+static void
+usage(void)
+{
+    die("usage: layoutbench [-n nmaster] [-m mfact] [-g gap] [-s] [-c] [-b minheight] [layout ...]");
+}
+
+/* borders are dropped for a lone tiled client and in monocle, see resizeclient */
+static int
+outside(Monitor *m, Client *c)
+{
+    int bw = (nexttiled(m->clients) == c && !nexttiled(c->next))
+        || m->lt[m->sellt]->arrange == monocle ? 0 : c->bw;
+
+    return c->x < m->wx || c->y < m->wy
+        || c->x + c->w + 2 * bw > m->wx + m->ww || c->y + c->h + 2 * bw > m->wy + m->wh;
+}
+
+static void
+run1(const char *name, void (*arrange)(Monitor *), Monitor *m, int n)
+{
+    Layout lt = { name, arrange };
+    unsigned long long t;
+    unsigned long req, iters, i, out = 0;
+    Client *c, **tc = &m->clients;
+
+    srand(n);
+    for (i = 0; i < n; i++) {
+        c = ecalloc(1, sizeof(Client));
+        c->win = i + 1;
+        c->mon = m;
+        c->tags = 1;
+        c->bw = borderpx;
+        c->cfact = varycfacts ? 0.5 + (rand() % 16) / 10.0 : 1.0;
+        *tc = c;
+        tc = &c->next;
+    }
+    m->lt[m->sellt] = &lt;
+
+    /* the window area changes every time, so every client is moved */
+    iters = MAX(10, 200000 / n);
+    req = XNextRequest(dpy);
+    t = prof_now();
+    for (i = 0; i < iters; i++) {
+        m->ww = sw - (i & 1) * 2;
+        arrange(m);
+    }
+    t = prof_now() - t;
+    req = XNextRequest(dpy) - req;
+
+    for (c = m->clients; c; c = c->next)
+        out += outside(m, c);
+    printf("%-24s %7d %8lu %12.0f %10.1f %8lu\n", name, n, iters,
+        (double)t / iters, (double)req / iters, out);
+
+    while ((c = m->clients)) {
+        m->clients = c->next;
+        free(c);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    Monitor *m;
+    int i, j, k, gap = 0;
+
+    sw = 1920;
+    sh = 1080;
+    m = ecalloc(1, sizeof(Monitor));
+    m->pertag = ecalloc(1, sizeof(Pertag));
+    m->pertag->curtag = 1;
+    m->pertag->enablegaps[1] = 1;
+    m->tagset[0] = 1;
+    m->nmaster = 1;
+    m->mfact = 0.55;
+    m->mx = m->wx = 0;
+    m->my = 0;
+    m->wy = 20;
+    m->mw = m->ww = sw;
+    m->mh = sh;
+    m->wh = sh - m->wy;
+    selmon = mons = m;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-s"))
+            m->smartgaps = 1;
+        else if (!strcmp(argv[i], "-c"))
+            varycfacts = 1;
+        else if (i + 1 == argc)
+            usage();
+        else if (!strcmp(argv[i], "-n"))
+            m->nmaster = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m"))
+            m->mfact = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-g"))
+            gap = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b"))
+            bh = atoi(argv[++i]);
+        else
+            usage();
+    }
+    m->gappih = m->gappiv = m->gappoh = m->gappov = gap;
+
+    printf("nmaster %d, mfact %.2f, gap %d%s, %dx%d\n", m->nmaster, m->mfact, gap,
+        m->smartgaps ? " (smart)" : "", m->ww, m->wh);
+    printf("%-24s %7s %8s %12s %10s %8s\n", "layout", "clients", "iters", "ns/arrange",
+        "req/arr", "outside");
+    for (j = 0; j < LENGTH(bench); j++) {
+        /* only the layouts named on the command line, if any */
+        for (k = i; k < argc && strcmp(argv[k], bench[j].name); k++);
+        if (i < argc && k == argc)
+            continue;
+        for (k = 0; k < LENGTH(counts); k++)
+            run1(bench[j].name, bench[j].arrange, m, counts[k]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Replays a recording made with dwm -r through handler[] against the stub
+ * display layer in xstub.c, then prints the event handler and internal
+ * profile. Commands that keychords would spawn are not run.
+ */
+#include <poll.h>
+#include <unistd.h>
+
+#define fork()  (-1)
+/* recorded events arrive at once, so pending keychords never time out */
+#define poll(fds, n, ms)    ((void)(fds), 1)
+#define main    dwmmain
+#include "../dwm.c"
+#undef main
+
+int
+main(int argc, char *argv[])
+{
+    unsigned long long t;
+    unsigned long n = 0;
+    int i;
+
+    if (argc != 2)
+        die("usage: replay file");
+    if (!rec_open(argv[1], NULL))
+        die("replay: cannot open '%s':", argv[1]);
+    if (!(dpy = XOpenDisplay(NULL)))
+        die("replay: '%s' is not a recording", argv[1]);
+    xcon = XGetXCBConnection(dpy);
+    profile = 1;
+
+    t = prof_now();
+    setup();
+    scan();
+    run();
+    t = prof_now() - t;
+
+    for (i = 0; i < LASTEvent; i++)
+        n += evhist[i].count;
+    printf("replay: %lu events in %.3f ms, %.0f events/s\n", n, t / 1e6, n / (t / 1e9));
+    dumpprofile(&((Arg) { .i = 0 }));
+    rec_close();
+    return EXIT_SUCCESS;
+}
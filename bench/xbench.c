@@ -0,0 +1,177 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Throughput benchmark: maps synthetic clients under the window manager on
+ * a headless X server and drives scripted workloads through the fake
+ * signal IPC, reporting operations per second and end-to-end latency.
+ * The window manager's own arrange timings come from its profile dump.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "harness.h"
+#include "../util.h"
+
+#define NLAYOUTS 10 /* entries of layouts[] in config.h */
+#define NTAGS    9
+
+static Harness h;
+static Window *wins;
+static int nwins;
+
+static void
+usage(void)
+{
+    die("usage: xbench [-n clients] [-r rounds] [-s tags] [-c class] [-T title]\n"
+        "              [-t transient-every] [-H hints] [-x server] [wm]");
+}
+
+static void
+report(const char *name, Samples *s, unsigned long long elapsed, size_t ops)
+{
+    printf("%-12s %8zu %12.1f", name, ops, ops / (elapsed / 1e9));
+    if (s && s->n)
+        printf(" %10.1f %10.1f\n", samples_pct(s, 50) / 1e3, samples_pct(s, 99) / 1e3);
+    else
+        printf(" %10s %10s\n", "-", "-");
+}
+
+/* runs cmd, formatted with each of the n values, rounds times */
+static void
+sweep(const char *name, const char *fmt, const double *v, int n, int rounds)
+{
+    Samples s = { 0 };
+    unsigned long long t;
+    char cmd[64];
+    int r, i;
+
+    t = now();
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < n; i++) {
+            snprintf(cmd, sizeof cmd, fmt, v[i]);
+            samples_add(&s, harness_fsignal(&h, cmd));
+        }
+    report(name, &s, now() - t, s.n);
+    free(s.v);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *class = "xbench", *title = "xbench client", *server = "Xvfb", *wm = "./dwm";
+    int i, r, rounds = 5, spread = NTAGS, transient = 0, hints = 0;
+    double v[NLAYOUTS * 2 + 1];
+    unsigned long count;
+    unsigned long long t, total, max;
+    char buf[256];
+    size_t n;
+    Samples s = { 0 };
+
+    nwins = 180;
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            wm = argv[i];
+            continue;
+        }
+        if (i + 1 == argc)
+            usage();
+        else if (!strcmp(argv[i], "-n"))
+            nwins = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r"))
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s"))
+            spread = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-c"))
+            class = argv[++i];
+        else if (!strcmp(argv[i], "-T"))
+            title = argv[++i];
+        else if (!strcmp(argv[i], "-t"))
+            transient = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-H"))
+            hints = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-x"))
+            server = argv[++i];
+        else
+            usage();
+    }
+    if (nwins < 1 || rounds < 1 || spread < 1 || spread > NTAGS)
+        usage();
+    if (!harness_start(&h, server, wm, 1920, 1080))
+        die("xbench: cannot start %s under %s", wm, server);
+    wins = ecalloc(nwins, sizeof *wins);
+
+    /* profile defaults to off in config.h */
+    harness_fsignal(&h, "toggleprofile");
+    printf("xbench: %d clients on %d tags, %d rounds, %s\n", nwins, spread, rounds, DisplayString(h.dpy));
+    printf("%-12s %8s %12s %10s %10s\n", "workload", "ops", "ops/s", "p50(us)", "p99(us)");
+
+    /* transients go to their parent's tag */
+    for (i = 0; i < nwins; i++) {
+        snprintf(buf, sizeof buf, "%s %d", title, i);
+        wins[i] = harness_client(&h, class, buf, 1 << (i % spread),
+            transient && i && i % transient == 0 ? wins[i - 1] : None, hints);
+    }
+    XSync(h.dpy, False);
+    t = now();
+    for (i = 0; i < nwins; i++)
+        XMapWindow(h.dpy, wins[i]);
+    XFlush(h.dpy);
+    if ((n = harness_waitstate(&h, nwins, NormalState)) < (size_t)nwins)
+        fprintf(stderr, "xbench: only %zu of %d clients were managed\n", n, nwins);
+    report("map", NULL, now() - t, n);
+
+    for (i = 0; i < NTAGS; i++)
+        v[i] = i;
+    sweep("viewex", "viewex i %.0f", v, NTAGS, rounds);
+
+    harness_fsignal(&h, "viewex i 0");
+    for (i = 0; i < NLAYOUTS; i++)
+        v[i] = i;
+    sweep("setlayoutex", "setlayoutex i %.0f", v, NLAYOUTS, rounds);
+
+    /* absolute factors, see setmfact */
+    harness_fsignal(&h, "setlayoutex i 0");
+    for (i = 0; i < 19; i++)
+        v[i] = 1.05 + i * 0.05;
+    sweep("setmfact", "setmfact f %.2f", v, 19, rounds);
+
+    /* cfact is relative, walk up to 3.0 and back */
+    for (i = 0; i < 16; i++)
+        v[i] = i < 8 ? 0.25 : -0.25;
+    sweep("setcfact", "setcfact f %.2f", v, 16, rounds);
+
+    /* the fence is handled after every title before it, so the
+     * latency is that of a whole batch */
+    total = now();
+    for (r = 0; r < rounds; r++) {
+        t = now();
+        for (i = 0; i < nwins; i++) {
+            snprintf(buf, sizeof buf, "%s %d.%d", title, i, r);
+            XStoreName(h.dpy, wins[i], buf);
+        }
+        harness_fsignal(&h, "sync");
+        samples_add(&s, now() - t);
+    }
+    report("titles", &s, now() - total, (size_t)nwins * rounds);
+    free(s.v);
+
+    t = now();
+    for (i = 0; i < nwins; i++)
+        XUnmapWindow(h.dpy, wins[i]);
+    XFlush(h.dpy);
+    n = harness_waitstate(&h, nwins, WithdrawnState);
+    report("unmap", NULL, now() - t, n);
+
+    if (harness_profile(&h, "arrange", &count, &total, &max))
+        printf("\narrange in wm: %lu calls, mean %.1f us, max %.1f us\n",
+            count, count ? total / 1e3 / count : 0, max / 1e3);
+    else
+        fprintf(stderr, "xbench: no arrange profile, xbench expects profile = 0 in config.h\n");
+
+    harness_stop(&h);
+    free(wins);
+    return 0;
+}
@@ -0,0 +1,726 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Stub display layer for replay: the Xlib, Xft, fontconfig, XRandR, Xinerama,
+ * Imlib2 and xcb functions dwm links against. Queries are answered from
+ * the recording (../record.c), requests are only counted and text is
+ * measured with fixed width glyphs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xlib-xcb.h>
+#include <X11/Xft/Xft.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/sync.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/XInput2.h>
+#ifdef XINERAMA
+#include <X11/extensions/Xinerama.h>
+#endif /* XINERAMA */
+#include <Imlib2.h>
+#include <xcb/res.h>
+
+#define RECORDER
+#include "../record.h"
+#include "../util.h"
+
+#define REQUEST        (requests++, 1)
+#define DUMMY(T)       ((T)&dummy)
+
+static char dummy;
+static unsigned long requests = 0, ids = 0x200000;
+
+static long
+reply(void)
+{
+    long status;
+
+    if (!rec_next(RecReply, &status))
+        die("replay: the recording ended while dwm waited for a reply");
+    return status;
+}
+
+/* Display */
+Display *
+XOpenDisplay(const char *name)
+{
+    _XPrivDisplay d;
+    Screen *s;
+    long screen[6], n;
+
+    if (!rec_next(RecDisplay, &n))
+        return NULL;
+    rec_get(screen, sizeof screen);
+    d = ecalloc(1, sizeof *d);
+    s = ecalloc(n + 1, sizeof *s);
+    d->fd = -1;
+    d->display_name = "replay";
+    d->nscreens = n + 1;
+    d->default_screen = n;
+    d->screens = s;
+    s += n;
+    s->display = (Display *)d;
+    s->root = screen[0];
+    s->width = screen[1];
+    s->height = screen[2];
+    s->mwidth = screen[3];
+    s->mheight = screen[4];
+    s->root_depth = screen[5];
+    s->root_visual = ecalloc(1, sizeof(Visual));
+    s->default_gc = DUMMY(GC);
+    s->cmap = ++ids;
+    s->white_pixel = 0xffffff;
+    return (Display *)d;
+}
+
+int
+XCloseDisplay(Display *dpy)
+{
+    _XPrivDisplay d = (_XPrivDisplay)dpy;
+
+    free(d->screens[d->default_screen].root_visual);
+    free(d->screens);
+    free(d);
+    return 0;
+}
+
+unsigned long
+XNextRequest(Display *dpy)
+{
+    return requests + 1;
+}
+
+Bool XSupportsLocale(void) { return True; }
+XErrorHandler XSetErrorHandler(XErrorHandler handler) { return NULL; }
+int XSync(Display *dpy, Bool discard) { return REQUEST; }
+int XFree(void *p) { free(p); return 1; }
+xcb_connection_t *XGetXCBConnection(Display *dpy) { return DUMMY(xcb_connection_t *); }
+
+/* Events, the end of the recording ends the event loop and any drag */
+/* idle where dwm was idle, and for good once the recording ends */
+int
+XPending(Display *dpy)
+{
+    long status;
+
+    return rec_next(RecReply, &status) ? status : 0;
+}
+
+int
+XPeekEvent(Display *dpy, XEvent *ev)
+{
+    long status;
+
+    if (!rec_next(RecEvent, &status)) {
+        memset(ev, 0, sizeof *ev);
+        return 1;
+    }
+    rec_getevent(dpy, ev);
+    return status;
+}
+
+int
+XNextEvent(Display *dpy, XEvent *ev)
+{
+    long status;
+
+    if (!rec_next(RecEvent, &status))
+        return 1;
+    rec_getevent(dpy, ev);
+    return status;
+}
+
+int
+XMaskEvent(Display *dpy, long mask, XEvent *ev)
+{
+    long status;
+
+    if (!rec_next(RecEvent, &status)) {
+        memset(ev, 0, sizeof *ev);
+        ev->type = ButtonRelease;
+        return 0;
+    }
+    rec_getevent(dpy, ev);
+    return status;
+}
+
+Bool
+XCheckMaskEvent(Display *dpy, long mask, XEvent *ev)
+{
+    long status;
+
+    if (!rec_next(RecEvent, &status) || !status)
+        return False;
+    rec_getevent(dpy, ev);
+    return True;
+}
+
+/* Queries */
+Atom XInternAtom(Display *dpy, const char *name, Bool exists) { return reply(); }
+Window XGetSelectionOwner(Display *dpy, Atom selection) { return reply(); }
+KeySym XKeycodeToKeysym(Display *dpy,
+#if NeedWidePrototypes
+    unsigned int code,
+#else
+    KeyCode code,
+#endif
+    int index) { return reply(); }
+KeyCode XKeysymToKeycode(Display *dpy, KeySym sym) { return reply(); }
+
+Window
+XCreateSimpleWindow(Display *dpy, Window parent, int x, int y, unsigned int w, unsigned int h,
+    unsigned int bw, unsigned long border, unsigned long bg)
+{
+    requests++;
+    return reply();
+}
+
+Window
+XCreateWindow(Display *dpy, Window parent, int x, int y, unsigned int w, unsigned int h,
+    unsigned int bw, int depth, unsigned int class, Visual *visual, unsigned long mask,
+    XSetWindowAttributes *wa)
+{
+    requests++;
+    return reply();
+}
+
+int
+XGrabPointer(Display *dpy, Window w, Bool owner, unsigned int mask, int pmode, int kmode,
+    Window confine, Cursor cursor, Time time)
+{
+    requests++;
+    return reply();
+}
+
+Status
+XGetClassHint(Display *dpy, Window w, XClassHint *ch)
+{
+    Status r = reply();
+
+    requests++;
+    if (r) {
+        ch->res_name = rec_getstr();
+        ch->res_class = rec_getstr();
+    }
+    return r;
+}
+
+int
+XGetInputFocus(Display *dpy, Window *focus, int *revert)
+{
+    int r = reply();
+
+    requests++;
+    rec_get(focus, sizeof *focus);
+    rec_get(revert, sizeof *revert);
+    return r;
+}
+
+/* the keycode range every server in practice reports */
+int
+XDisplayKeycodes(Display *dpy, int *min, int *max)
+{
+    *min = 8;
+    *max = 255;
+    return 1;
+}
+
+KeySym *
+XGetKeyboardMapping(Display *dpy,
+#if NeedWidePrototypes
+    unsigned int first,
+#else
+    KeyCode first,
+#endif
+    int count, int *per)
+{
+    requests++;
+    if (!reply())
+        return NULL;
+    rec_get(per, sizeof *per);
+    return rec_getalloc(count * *per * sizeof(KeySym));
+}
+
+XModifierKeymap *
+XGetModifierMapping(Display *dpy)
+{
+    XModifierKeymap *m;
+
+    requests++;
+    if (!reply())
+        return NULL;
+    m = ecalloc(1, sizeof *m);
+    rec_get(&m->max_keypermod, sizeof m->max_keypermod);
+    m->modifiermap = rec_getalloc(8 * m->max_keypermod);
+    return m;
+}
+
+int
+XFreeModifiermap(XModifierKeymap *m)
+{
+    free(m->modifiermap);
+    free(m);
+    return 1;
+}
+
+Status
+XGetTextProperty(Display *dpy, Window w, XTextProperty *tp, Atom atom)
+{
+    Status r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(&tp->encoding, sizeof tp->encoding);
+        rec_get(&tp->format, sizeof tp->format);
+        rec_get(&tp->nitems, sizeof tp->nitems);
+        tp->value = rec_getalloc(tp->nitems * tp->format / 8);
+    }
+    return r;
+}
+
+Status
+XGetTransientForHint(Display *dpy, Window w, Window *trans)
+{
+    Status r = reply();
+
+    requests++;
+    rec_get(trans, sizeof *trans);
+    return r;
+}
+
+Status
+XGetWindowAttributes(Display *dpy, Window w, XWindowAttributes *wa)
+{
+    Status r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(wa, sizeof *wa);
+        wa->visual = DefaultVisual(dpy, DefaultScreen(dpy));
+        wa->screen = DefaultScreenOfDisplay(dpy);
+    }
+    return r;
+}
+
+int
+XGetWindowProperty(Display *dpy, Window w, Atom prop, long off, long len, Bool del,
+    Atom req, Atom *type, int *format, unsigned long *n, unsigned long *after, unsigned char **p)
+{
+    int r = reply();
+
+    requests++;
+    if (r != Success)
+        return r;
+    rec_get(type, sizeof *type);
+    rec_get(format, sizeof *format);
+    rec_get(n, sizeof *n);
+    rec_get(after, sizeof *after);
+    *p = *type == None ? NULL : rec_getalloc(*n * (*format == 32 ? sizeof(long) : *format / 8));
+    return r;
+}
+
+XWMHints *
+XGetWMHints(Display *dpy, Window w)
+{
+    requests++;
+    return reply() ? rec_getalloc(sizeof(XWMHints)) : NULL;
+}
+
+Status
+XGetWMNormalHints(Display *dpy, Window w, XSizeHints *hints, long *supplied)
+{
+    Status r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(hints, sizeof *hints);
+        rec_get(supplied, sizeof *supplied);
+    }
+    return r;
+}
+
+Status
+XGetWMProtocols(Display *dpy, Window w, Atom **protocols, int *n)
+{
+    Status r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(n, sizeof *n);
+        *protocols = rec_getalloc(*n * sizeof **protocols);
+    }
+    return r;
+}
+
+Bool
+XQueryExtension(Display *dpy, const char *name, int *opcode, int *event, int *error)
+{
+    Bool r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(opcode, sizeof *opcode);
+        rec_get(event, sizeof *event);
+        rec_get(error, sizeof *error);
+    }
+    return r;
+}
+
+Bool
+XQueryPointer(Display *dpy, Window w, Window *root, Window *child, int *rx, int *ry,
+    int *x, int *y, unsigned int *mask)
+{
+    Bool r = reply();
+
+    requests++;
+    rec_get(root, sizeof *root);
+    rec_get(child, sizeof *child);
+    rec_get(rx, sizeof *rx);
+    rec_get(ry, sizeof *ry);
+    rec_get(x, sizeof *x);
+    rec_get(y, sizeof *y);
+    rec_get(mask, sizeof *mask);
+    return r;
+}
+
+Status
+XQueryTree(Display *dpy, Window w, Window *root, Window *parent, Window **children,
+    unsigned int *n)
+{
+    Status r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(root, sizeof *root);
+        rec_get(parent, sizeof *parent);
+        rec_get(n, sizeof *n);
+        *children = *n ? rec_getalloc(*n * sizeof **children) : NULL;
+    }
+    return r;
+}
+
+#ifdef XINERAMA
+Bool XineramaIsActive(Display *dpy) { requests++; return reply(); }
+
+XineramaScreenInfo *
+XineramaQueryScreens(Display *dpy, int *n)
+{
+    requests++;
+    *n = 0;
+    if (!reply())
+        return NULL;
+    rec_get(n, sizeof *n);
+    return rec_getalloc(*n * sizeof(XineramaScreenInfo));
+}
+#endif /* XINERAMA */
+
+/* Text properties, the recorded text is used as is */
+int
+XmbTextPropertyToTextList(Display *dpy, const XTextProperty *tp, char ***list, int *n)
+{
+    char **l = ecalloc(1, sizeof *l + tp->nitems + 1);
+
+    l[0] = (char *)(l + 1);
+    memcpy(l[0], tp->value, tp->nitems);
+    *list = l;
+    *n = 1;
+    return Success;
+}
+
+int
+Xutf8TextListToTextProperty(Display *dpy, char **list, int n, XICCEncodingStyle style,
+    XTextProperty *tp)
+{
+    tp->value = (unsigned char *)strdup(n ? list[0] : "");
+    tp->encoding = XA_STRING;
+    tp->format = 8;
+    tp->nitems = strlen((char *)tp->value);
+    return Success;
+}
+
+void XFreeStringList(char **list) { free(list); }
+
+/* Requests */
+int XAddToSaveSet(Display *dpy, Window w) { return REQUEST; }
+int XAllowEvents(Display *dpy, int mode, Time time) { return REQUEST; }
+int XChangeProperty(Display *dpy, Window w, Atom prop, Atom type, int format, int mode,
+    const unsigned char *data, int n) { return REQUEST; }
+int XChangeWindowAttributes(Display *dpy, Window w, unsigned long mask,
+    XSetWindowAttributes *wa) { return REQUEST; }
+int XConfigureWindow(Display *dpy, Window w, unsigned int mask, XWindowChanges *wc) { return REQUEST; }
+int XCopyArea(Display *dpy, Drawable src, Drawable dst, GC gc, int sx, int sy, unsigned int w,
+    unsigned int h, int dx, int dy) { return REQUEST; }
+Cursor XCreateFontCursor(Display *dpy, unsigned int shape) { requests++; return ++ids; }
+GC XCreateGC(Display *dpy, Drawable d, unsigned long mask, XGCValues *gcv) { requests++; return DUMMY(GC); }
+Pixmap XCreatePixmap(Display *dpy, Drawable d, unsigned int w, unsigned int h,
+    unsigned int depth) { requests++; return ++ids; }
+int XDefineCursor(Display *dpy, Window w, Cursor cursor) { return REQUEST; }
+int XDeleteProperty(Display *dpy, Window w, Atom prop) { return REQUEST; }
+int XDestroyWindow(Display *dpy, Window w) { return REQUEST; }
+int XDrawRectangle(Display *dpy, Drawable d, GC gc, int x, int y, unsigned int w,
+    unsigned int h) { return REQUEST; }
+int XFillRectangle(Display *dpy, Drawable d, GC gc, int x, int y, unsigned int w,
+    unsigned int h) { return REQUEST; }
+int XFreeCursor(Display *dpy, Cursor cursor) { return REQUEST; }
+int XFreeGC(Display *dpy, GC gc) { return REQUEST; }
+int XFreePixmap(Display *dpy, Pixmap p) { return REQUEST; }
+int XGrabButton(Display *dpy, unsigned int button, unsigned int mod, Window w, Bool owner,
+    unsigned int mask, int pmode, int kmode, Window confine, Cursor cursor) { return REQUEST; }
+int XGrabKey(Display *dpy, int code, unsigned int mod, Window w, Bool owner, int pmode,
+    int kmode) { return REQUEST; }
+int XGrabServer(Display *dpy) { return REQUEST; }
+int XKillClient(Display *dpy, XID resource) { return REQUEST; }
+int XMapRaised(Display *dpy, Window w) { return REQUEST; }
+int XMapSubwindows(Display *dpy, Window w) { return REQUEST; }
+int XMapWindow(Display *dpy, Window w) { return REQUEST; }
+int XMoveResizeWindow(Display *dpy, Window w, int x, int y, unsigned int width,
+    unsigned int height) { return REQUEST; }
+int XMoveWindow(Display *dpy, Window w, int x, int y) { return REQUEST; }
+int XRaiseWindow(Display *dpy, Window w) { return REQUEST; }
+int XRefreshKeyboardMapping(XMappingEvent *ev) { return 1; }
+int XReparentWindow(Display *dpy, Window w, Window parent, int x, int y) { return REQUEST; }
+int XSelectInput(Display *dpy, Window w, long mask) { return REQUEST; }
+Status XSendEvent(Display *dpy, Window w, Bool propagate, long mask, XEvent *ev) { return REQUEST; }
+int XSetClassHint(Display *dpy, Window w, XClassHint *ch) { return REQUEST; }
+int XSetCloseDownMode(Display *dpy, int mode) { return REQUEST; }
+int XSetForeground(Display *dpy, GC gc, unsigned long pixel) { return REQUEST; }
+int XSetInputFocus(Display *dpy, Window w, int revert, Time time) { return REQUEST; }
+int XSetLineAttributes(Display *dpy, GC gc, unsigned int width, int line, int cap,
+    int join) { return REQUEST; }
+int XSetSelectionOwner(Display *dpy, Atom selection, Window owner, Time time) { return REQUEST; }
+void XSetTextProperty(Display *dpy, Window w, XTextProperty *tp, Atom prop) { requests++; }
+int XSetWMHints(Display *dpy, Window w, XWMHints *hints) { return REQUEST; }
+int XSetWindowBackgroundPixmap(Display *dpy, Window w, Pixmap p) { return REQUEST; }
+int XSetWindowBorder(Display *dpy, Window w, unsigned long pixel) { return REQUEST; }
+int XStoreName(Display *dpy, Window w, const char *name) { return REQUEST; }
+int XUngrabButton(Display *dpy, unsigned int button, unsigned int mod, Window w) { return REQUEST; }
+int XUngrabKey(Display *dpy, int code, unsigned int mod, Window w) { return REQUEST; }
+int XUngrabPointer(Display *dpy, Time time) { return REQUEST; }
+int XUngrabServer(Display *dpy) { return REQUEST; }
+int XUnmapWindow(Display *dpy, Window w) { return REQUEST; }
+int XWarpPointer(Display *dpy, Window src, Window dst, int sx, int sy, unsigned int sw,
+    unsigned int sh, int dx, int dy) { return REQUEST; }
+
+/* Xft and fontconfig, every glyph is there and half as wide as high */
+XftFont *
+XftFontOpenName(Display *dpy, int screen, const char *name)
+{
+    XftFont *f = ecalloc(1, sizeof *f);
+
+    f->ascent = 12;
+    f->descent = 4;
+    f->height = 16;
+    f->max_advance_width = 8;
+    return f;
+}
+
+XftFont *
+XftFontOpenPattern(Display *dpy, FcPattern *pattern)
+{
+    return XftFontOpenName(dpy, 0, NULL);
+}
+
+void XftFontClose(Display *dpy, XftFont *f) { free(f); }
+FcBool XftCharExists(Display *dpy, XftFont *f, FcChar32 c) { return FcTrue; }
+FcPattern *XftFontMatch(Display *dpy, int screen, const FcPattern *p, FcResult *r) { return NULL; }
+
+void
+XftTextExtentsUtf8(Display *dpy, XftFont *f, const FcChar8 *s, int len, XGlyphInfo *ext)
+{
+    memset(ext, 0, sizeof *ext);
+    ext->width = ext->xOff = len * f->max_advance_width;
+    ext->height = f->height;
+}
+
+Bool
+XftColorAllocName(Display *dpy, const Visual *visual, Colormap cmap, const char *name,
+    XftColor *color)
+{
+    memset(color, 0, sizeof *color);
+    color->color.alpha = 0xffff;
+    return True;
+}
+
+XftDraw *XftDrawCreate(Display *dpy, Drawable d, Visual *visual, Colormap cmap) { return DUMMY(XftDraw *); }
+void XftDrawDestroy(XftDraw *d) { }
+void XftDrawStringUtf8(XftDraw *d, const XftColor *color, XftFont *f, int x, int y,
+    const FcChar8 *s, int len) { requests++; }
+
+FcCharSet *FcCharSetCreate(void) { return DUMMY(FcCharSet *); }
+FcBool FcCharSetAddChar(FcCharSet *cs, FcChar32 c) { return FcTrue; }
+void FcCharSetDestroy(FcCharSet *cs) { }
+FcPattern *FcNameParse(const FcChar8 *name) { return DUMMY(FcPattern *); }
+FcPattern *FcPatternDuplicate(const FcPattern *p) { return DUMMY(FcPattern *); }
+FcBool FcPatternAddBool(FcPattern *p, const char *object, FcBool b) { return FcTrue; }
+FcBool FcPatternAddCharSet(FcPattern *p, const char *object, const FcCharSet *cs) { return FcTrue; }
+FcBool FcConfigSubstitute(FcConfig *config, FcPattern *p, FcMatchKind kind) { return FcTrue; }
+void FcDefaultSubstitute(FcPattern *p) { }
+void FcPatternDestroy(FcPattern *p) { }
+
+/* Images, previews are dropped instead of packed */
+XImage *XGetImage(Display *dpy, Drawable d, int x, int y, unsigned int w, unsigned int h,
+    unsigned long mask, int format) { return NULL; }
+XImage *XCreateImage(Display *dpy, Visual *v, unsigned int depth, int format, int offset,
+    char *data, unsigned int w, unsigned int h, int pad, int bpl) { die("replay: XCreateImage"); return NULL; }
+int XPutImage(Display *dpy, Drawable d, GC gc, XImage *img, int sx, int sy, int dx, int dy,
+    unsigned int w, unsigned int h) { return REQUEST; }
+
+/* MIT-SHM, never used: replay takes the Imlib2 path for tag previews */
+Bool XShmQueryExtension(Display *dpy) { return False; }
+XImage *XShmCreateImage(Display *dpy, Visual *v, unsigned int depth, int format, char *data,
+    XShmSegmentInfo *si, unsigned int w, unsigned int h) { return NULL; }
+Bool XShmAttach(Display *dpy, XShmSegmentInfo *si) { return False; }
+Bool XShmDetach(Display *dpy, XShmSegmentInfo *si) { return False; }
+Bool XShmGetImage(Display *dpy, Drawable d, XImage *img, int x, int y, unsigned long mask) { return False; }
+Bool XShmPutImage(Display *dpy, Drawable d, GC gc, XImage *img, int sx, int sy, int dx, int dy,
+    unsigned int w, unsigned int h, Bool send) { return False; }
+
+/* XDamage, absent: every tag switch captures */
+Bool XDamageQueryExtension(Display *dpy, int *event, int *error) { return False; }
+Damage XDamageCreate(Display *dpy, Drawable d, int level) { return ++ids; }
+void XDamageDestroy(Display *dpy, Damage damage) { }
+void XDamageSubtract(Display *dpy, Damage damage, XserverRegion repair, XserverRegion parts) { }
+Bool XCheckTypedEvent(Display *dpy, int type, XEvent *ev) { return False; }
+
+/* XRandR, the version and monitors are recorded but crtcs are not: drags
+ * are paced at 60 Hz */
+Bool
+XRRQueryExtension(Display *dpy, int *event, int *error)
+{
+    Bool r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(event, sizeof *event);
+        rec_get(error, sizeof *error);
+    }
+    return r;
+}
+
+Status
+XRRQueryVersion(Display *dpy, int *major, int *minor)
+{
+    Status r = reply();
+
+    requests++;
+    if (r) {
+        rec_get(major, sizeof *major);
+        rec_get(minor, sizeof *minor);
+    }
+    return r;
+}
+
+XRRMonitorInfo *
+XRRGetMonitors(Display *dpy, Window w, Bool active, int *n)
+{
+    XRRMonitorInfo *r;
+    int i;
+
+    requests++;
+    *n = 0;
+    if (!reply())
+        return NULL;
+    rec_get(n, sizeof *n);
+    r = rec_getalloc(*n * sizeof *r);
+    for (i = 0; i < *n; i++) {
+        r[i].noutput = 0;
+        r[i].outputs = NULL;
+    }
+    return r;
+}
+
+void XRRFreeMonitors(XRRMonitorInfo *monitors) { free(monitors); }
+void XRRSelectInput(Display *dpy, Window w, int mask) { requests++; }
+int XRRUpdateConfiguration(XEvent *ev) { return 1; }
+XRRScreenResources *XRRGetScreenResourcesCurrent(Display *dpy, Window w) { return NULL; }
+void XRRFreeScreenResources(XRRScreenResources *res) { }
+XRRCrtcInfo *XRRGetCrtcInfo(Display *dpy, XRRScreenResources *res, RRCrtc crtc) { return NULL; }
+void XRRFreeCrtcInfo(XRRCrtcInfo *ci) { }
+
+/* XInput2, raw motion is recorded like any other event */
+Status
+XIQueryVersion(Display *dpy, int *major, int *minor)
+{
+    Status r = reply();
+
+    requests++;
+    rec_get(major, sizeof *major);
+    rec_get(minor, sizeof *minor);
+    return r;
+}
+
+int XISelectEvents(Display *dpy, Window w, XIEventMask *masks, int n) { requests++; return Success; }
+
+/* XSync, absent: resizes do not wait for clients to draw */
+Status XSyncQueryExtension(Display *dpy, int *event, int *error) { return False; }
+Status XSyncInitialize(Display *dpy, int *major, int *minor) { return False; }
+Status XSyncQueryCounter(Display *dpy, XSyncCounter counter, XSyncValue *v) { return False; }
+XSyncAlarm XSyncCreateAlarm(Display *dpy, unsigned long mask, XSyncAlarmAttributes *aa) { return ++ids; }
+Status XSyncChangeAlarm(Display *dpy, XSyncAlarm alarm, unsigned long mask,
+    XSyncAlarmAttributes *aa) { return True; }
+Status XSyncDestroyAlarm(Display *dpy, XSyncAlarm alarm) { return True; }
+void XSyncIntToValue(XSyncValue *v, int i) { v->hi = i < 0 ? -1 : 0; v->lo = i; }
+void XSyncIntsToValue(XSyncValue *v, unsigned int lo, int hi) { v->hi = hi; v->lo = lo; }
+int XSyncValueHigh32(XSyncValue v) { return v.hi; }
+unsigned int XSyncValueLow32(XSyncValue v) { return v.lo; }
+
+/* XComposite and XRender, absent: previews are captured */
+Bool XCompositeQueryExtension(Display *dpy, int *event, int *error) { return False; }
+Status XCompositeQueryVersion(Display *dpy, int *major, int *minor) { return 0; }
+void XCompositeRedirectSubwindows(Display *dpy, Window w, int update) { }
+void XCompositeUnredirectSubwindows(Display *dpy, Window w, int update) { }
+Pixmap XCompositeNameWindowPixmap(Display *dpy, Window w) { return ++ids; }
+Bool XRenderQueryExtension(Display *dpy, int *event, int *error) { return False; }
+XRenderPictFormat *XRenderFindVisualFormat(Display *dpy, const Visual *v) { return NULL; }
+Picture XRenderCreatePicture(Display *dpy, Drawable d, const XRenderPictFormat *format,
+    unsigned long mask, const XRenderPictureAttributes *attr) { return ++ids; }
+void XRenderSetPictureTransform(Display *dpy, Picture p, XTransform *xf) { }
+void XRenderSetPictureFilter(Display *dpy, Picture p, const char *filter, XFixed *params, int n) { }
+void XRenderComposite(Display *dpy, int op, Picture src, Picture mask, Picture dst, int sx, int sy,
+    int mx, int my, int dx, int dy, unsigned int w, unsigned int h) { }
+void XRenderFreePicture(Display *dpy, Picture p) { }
+
+/* Imlib2, previews stay blank */
+void imlib_context_set_display(Display *dpy) { }
+void imlib_context_set_visual(Visual *visual) { }
+void imlib_context_set_drawable(Drawable d) { }
+void imlib_context_set_image(Imlib_Image image) { }
+Imlib_Image imlib_create_image(int w, int h) { return DUMMY(Imlib_Image); }
+void imlib_free_image(void) { }
+void imlib_copy_drawable_to_image(Pixmap mask, int x, int y, int w, int h, int dx, int dy,
+    char grab) { requests++; }
+void imlib_render_image_part_on_drawable_at_size(int sx, int sy, int sw, int sh, int x, int y,
+    int w, int h) { requests++; }
+
+/* xcb-res, no client has a pid */
+xcb_res_query_client_ids_cookie_t
+xcb_res_query_client_ids(xcb_connection_t *c, uint32_t n, const xcb_res_client_id_spec_t *specs)
+{
+    xcb_res_query_client_ids_cookie_t cookie = { 0 };
+
+    requests++;
+    return cookie;
+}
+
+xcb_res_query_client_ids_reply_t *
+xcb_res_query_client_ids_reply(xcb_connection_t *c, xcb_res_query_client_ids_cookie_t cookie,
+    xcb_generic_error_t **e)
+{
+    return NULL;
+}
+
+xcb_res_client_id_value_iterator_t
+xcb_res_query_client_ids_ids_iterator(const xcb_res_query_client_ids_reply_t *r)
+{
+    xcb_res_client_id_value_iterator_t i = { 0 };
+
+    return i;
+}
+
+void xcb_res_client_id_value_next(xcb_res_client_id_value_iterator_t *i) { i->rem = 0; }
+uint32_t *xcb_res_client_id_value_value(const xcb_res_client_id_value_t *v) { return NULL; }
@@ -3,6 +3,12 @@ static const int showtab                   = showtab_never; /* Default tab bar s
 static const int toptab                    = 0; /* False means bottom tab bar */
 static       int showpreview               = 0; /* show tag preview */
 static const int scalepreview              = 4; /* tag preview scaling */
+static const unsigned int previewsettle    = 200; /* ms a client brought into view by a tag switch has to redraw, what it draws by then is not taken as a change */
+static const unsigned long previewbudget   = 32 << 20; /* bytes of tag previews kept across monitors */
+static const int previewcompress           = 1; /* 1 means evicted previews are kept client-side as RGB565 */
+static const int previewlive               = 0; /* 1 means previews are drawn from the live windows with XComposite */
+static       int profile                   = 0; /* 1 means time event handlers and internals, dump with SIGUSR1 */
+static const char tracefile[]              = "/tmp/dwm-trace.json"; /* dwmc dumptrace writes here */
 static const int showbar                   = 1; /* 0 means no bar */
 static const int topbar                    = 1; /* 0 means bottom bar */
 static const int horizpadbar               = 0; /* horizontal padding for statusbar */
@@ -33,6 +39,11 @@ static const unsigned int snap             = 0; /* snap pixel */
 static const int startontag                = 1; /* 0 means no tag active on start */
 static const int decorhints                = 1; /* 1 means respect decoration hints */
 static const int focusonwheel              = 0;
+static const unsigned int keychordtimeout  = 0; /* ms before an unfinished keychord is dropped, 0 means never */
+static const int dragmode                  = DragLive; /* DragLive, DragOutline or DragHybrid moves and resizes, rules can override it */
+static const unsigned int dragpause        = 150; /* ms the pointer rests before a DragHybrid drag updates the window */
+static const unsigned int syncrequesttimeout = 100; /* ms a client gets to draw a resize before the next one goes out anyway */
+static const int rawmotion                 = 0; /* 1 means XInput2 raw motion tells when the tracked pointer position is stale, at a wakeup per motion; 0 asks the server whenever the pointer is in a client */
 static const char *fonts[] = { "ComicCodeLigatures Nerd Font:size=10:antialias=true:autohint=true" };
 
 static const char normfg[]                = "#4e5579";
@@ -148,30 +159,30 @@ static const char *scpcal[]   = { "y", "qalculate-gtk", "--title", "calSCP", NUL
 #define WTYPE "_NET_WM_WINDOW_TYPE_"
 
 static const Rule rules[] = {
-    /* class      instance    title          wintype tags mask switchtotag isfloating iscentered ispermanent isterminal noswallow monitor scratch key */
+    /* class      instance    title          wintype tags mask switchtotag isfloating iscentered ispermanent isterminal noswallow monitor scratch key drag */
     /* Scratchpads */
-    { "scpclean", NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          0,         0,        -1, 'u' },
-    { "scpcmus",  NULL,       NULL,          NULL,   0,        0,          0,         0,         1,          0,         0,        -1, 'i' },
-    { NULL,       NULL,       "calSCP",      NULL,   0,        0,          1,         1,         0,          0,         0,        -1, 'y' },
+    { "scpclean", NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          0,         0,        -1, 'u', 0 },
+    { "scpcmus",  NULL,       NULL,          NULL,   0,        0,          0,         0,         1,          0,         0,        -1, 'i', 0 },
+    { NULL,       NULL,       "calSCP",      NULL,   0,        0,          1,         1,         0,          0,         0,        -1, 'y', 0 },
     /* Swallow */
-    { "St",       NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0 },
-    { "Alacritty",NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0 },
-    { "XTerm",    NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0 },
-    { "Emacs",    NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0 },
+    { "St",       NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0, 0 },
+    { "Alacritty",NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0, 0 },
+    { "XTerm",    NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0, 0 },
+    { "Emacs",    NULL,       NULL,          NULL,   0,        0,          0,         0,         0,          1,         0,        -1, 0, 0 },
     /* Noswallow */
-    { NULL,       NULL,       "Event Tester",NULL,   0,        0,          0,         0,         0,          0,         1,        -1, 0 },
-    { "Xephyr",   NULL,       NULL,          NULL,   0,        0,          1,         1,         0,          0,         1,        -1, 0 },
-    { "Gimp",     NULL,       NULL,          NULL,   1 << 8,   3,          1,         1,         0,          0,         1,        -1, 0 },
-    { NULL,       NULL,       "glxgears",    NULL,   0,        0,          1,         0,         0,          0,         1,        -1, 0 },
+    { NULL,       NULL,       "Event Tester",NULL,   0,        0,          0,         0,         0,          0,         1,        -1, 0, 0 },
+    { "Xephyr",   NULL,       NULL,          NULL,   0,        0,          1,         1,         0,          0,         1,        -1, 0, 0 },
+    { "Gimp",     NULL,       NULL,          NULL,   1 << 8,   3,          1,         1,         0,          0,         1,        -1, 0, 0 },
+    { NULL,       NULL,       "glxgears",    NULL,   0,        0,          1,         0,         0,          0,         1,        -1, 0, DragOutline },
     /* General windows */
-    { NULL,       "Navigator",NULL,          NULL,   1,        0,          0,         0,         1,          0,         1,         1, 0 },
-    { NULL,       "chromium", NULL,          NULL,   1 << 3,   0,          0,         0,         1,          0,         1,         1, 0 },
-    // { NULL,       "discord",  NULL,          NULL,   1,        0,          0,         0,         0,          0,         0,         1, 0 },
+    { NULL,       "Navigator",NULL,          NULL,   1,        0,          0,         0,         1,          0,         1,         1, 0, 0 },
+    { NULL,       "chromium", NULL,          NULL,   1 << 3,   0,          0,         0,         1,          0,         1,         1, 0, 0 },
+    // { NULL,       "discord",  NULL,          NULL,   1,        0,          0,         0,         0,          0,         0,         1, 0, 0 },
     /* Wintype */
-    { NULL,       NULL,       NULL, WTYPE "DIALOG",  0,        0,          1,         1,         0,          0,         0,        -1, 0 },
-    { NULL,       NULL,       NULL, WTYPE "UTILITY", 0,        0,          1,         1,         0,          0,         0,        -1, 0 },
-    { NULL,       NULL,       NULL, WTYPE "TOOLBAR", 0,        0,          1,         1,         0,          0,         0,        -1, 0 },
-    { NULL,       NULL,       NULL, WTYPE "SPLASH",  0,        0,          1,         1,         0,          0,         0,        -1, 0 },
+    { NULL,       NULL,       NULL, WTYPE "DIALOG",  0,        0,          1,         1,         0,          0,         0,        -1, 0, 0 },
+    { NULL,       NULL,       NULL, WTYPE "UTILITY", 0,        0,          1,         1,         0,          0,         0,        -1, 0, 0 },
+    { NULL,       NULL,       NULL, WTYPE "TOOLBAR", 0,        0,          1,         1,         0,          0,         0,        -1, 0, 0 },
+    { NULL,       NULL,       NULL, WTYPE "SPLASH",  0,        0,          1,         1,         0,          0,         0,        -1, 0, 0 },
 };
 
 static const int resizehints = 0;
@@ -376,4 +387,11 @@ static Signal signals[] = {
     { "tagwithex",      tagwithex },
     { "toggletagex",    toggletagex },
     { "setlayoutex",    setlayoutex },
+    { "setmfact",       setmfact },
+    { "setcfact",       setcfact },
+    { "toggleprofile",  toggleprofile },
+    { "dumpprofile",    dumpprofile },
+    { "toggletrace",    toggletrace },
+    { "dumptrace",      dumptrace },
+    { "sync",           NULL }, /* does nothing, its ack tells the sender all before it is handled */
 };
@@ -6,6 +6,7 @@
 #include <X11/Xft/Xft.h>
 
 #include "drw.h"
+#include "prof.h"
 #include "util.h"
 
 #define UTF_INVALID 0xFFFD
@@ -125,6 +126,7 @@ xfont_create(Drw *drw, const char *fontname, FcPattern *fontpattern)
             return NULL;
         }
     } else if (fontpattern) {
+        fontloads++;
         if (!(xfont = XftFontOpenPattern(drw->dpy, fontpattern))) {
             fprintf(stderr, "error, cannot load font from pattern.\n");
             return NULL;
@@ -257,6 +259,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 
     if (!drw || (render && !drw->scheme) || !text || !drw->fonts)
         return 0;
+    TRACEBEGIN("drw_text");
 
     if (!render) {
         w = ~w;
@@ -364,6 +367,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
     }
     if (d)
         XftDrawDestroy(d);
+    TRACEEND("drw_text");
 
     return x + (render ? w : 0);
 }
@@ -394,6 +398,7 @@ drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w,
     if (!font || !text)
         return;
 
+    xftextents++;
     XftTextExtentsUtf8(font->dpy, font->xfont, (XftChar8 *)text, len, &ext);
     if (w)
         *w = ext.xOff;
@@ -22,12 +22,15 @@
 #include <errno.h>
 #include <limits.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <X11/cursorfont.h>
@@ -36,6 +39,13 @@
 #include <X11/Xlib.h>
 #include <X11/Xproto.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xrender.h>
+#include <X11/extensions/sync.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/XInput2.h>
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
@@ -49,6 +59,9 @@
 #endif /* __OpenBSD */
 
 #include "drw.h"
+#include "preview.h"
+#include "prof.h"
+#include "record.h"
 #include "util.h"
 
 /* macros */
@@ -63,6 +76,13 @@
 #define HEIGHT(X)               ((X)->h + 2 * (X)->bw)
 #define TAGMASK                 ((1 << LENGTH(tags)) - 1)
 #define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define KEYHASH(T, M, K)        ((unsigned int)(K) * 31 + (M) * 7 + (T))
+#define SNAPROWS                32 /* preview rows read back per XShmGetImage */
+#define KEYLEVELS               4  /* shift levels kept in keysyms[] */
+#define HOSTBYTEORDER           (*(unsigned char *)&(unsigned int){ 1 } ? LSBFirst : MSBFirst)
+#define DRAGPROBE               8  /* drag updates per one that waits for the server */
+#define PROFBEGIN()             ProfMark prof_m = { 0 }; (profile ? profbegin(&prof_m) : (void)0)
+#define PROFEND(P)              (prof_m.t ? profend(&profhist[P], &prof_m) : (void)0)
 
 #define MWM_HINTS_FLAGS_FIELD       0
 #define MWM_HINTS_DECORATIONS_FIELD 2
@@ -88,18 +108,23 @@
 
 /* enums */
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
+enum { DragDefault, DragLive, DragOutline, DragHybrid }; /* move and resize modes */
 enum { SchemeNorm, SchemeSel, SchemeInv, SchemeOccupied, SchemeStatus, SchemeLtsymbol,
        SchemeTabNorm, SchemeTabSel, SchemeClientVac, SchemeClient, SchemeClientNum, SchemeInvLtsymbol,
        SchemeSystray, SchemeNormLayout, SchemeSelLayout }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
        NetSystemTray, NetSystemTrayOP, NetSystemTrayOrientation, NetSystemTrayOrientationHorz,
        NetWMFullscreen, NetActiveWindow, NetWMWindowType, NetWMWindowTypeDock, NetWMWindowTypeDialog,
-       NetClientList, NetDesktopNames, NetDesktopViewport, NetNumberOfDesktops, NetCurrentDesktop, NetLast }; /* EWMH atoms */
+       NetClientList, NetDesktopNames, NetDesktopViewport, NetNumberOfDesktops, NetCurrentDesktop,
+       NetWMSyncRequest, NetWMSyncRequestCounter, NetLast }; /* EWMH atoms */
 enum { Manager, Xembed, XembedInfo, XLast }; /* Xembed atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
 enum { IsFloating, IsSticky, IsFullscreen, Tag, Cfact, Scratchkey, ClientLast }; /* dusk client atoms */
+enum { GrabNone, GrabStale, GrabFocused, GrabUnfocused }; /* button grabs */
 enum { ClkTagBar, ClkTabBar, ClkLtSymbol, ClkNumSymbol, ClkStatusText, ClkClientWin,
        ClkRootWin, ClkLast }; /* clicks */
+enum { ProfArrange, ProfDrawbar, ProfDrawtab, ProfManage, ProfSwitchtag, ProfCapturetag,
+       ProfFocus, ProfLast }; /* profiled internals */
 
 typedef union {
     int i;
@@ -137,8 +162,44 @@ struct Client {
     Client *swallowing;
     Monitor *mon;
     Window win;
+    Atom homename; /* monitor it was moved off when that went away */
+    int grabstate; /* button grabs on win, see grabbuttons */
+    int dragmode; /* from its rule, DragDefault follows config.h */
+    XSyncAlarm syncalarm; /* fires when the client has drawn a sync request */
+    unsigned long long syncvalue; /* of the last sync request */
+    unsigned long long syncdue; /* ns, when waiting for it times out */
+    int syncwait, syncpending;
+    int syncw, synch; /* size the last sync request was for */
+    XWindowChanges syncwc; /* held back until the client has drawn */
+    XRenderPictFormat *format; /* of the window, for live previews */
+    Damage damage; /* reports that it drew, for tag previews */
+    int hidden; /* moved out of view by showhide */
+    unsigned long long exposed; /* ns, when showhide last brought it back */
 };
 
+typedef struct {
+    Client *c;              /* NULL while no move or resize is under way */
+    int resize;
+    int x, y;               /* pointer where a move started */
+    int ocx, ocy, ocx2, ocy2;
+    int horizcorner, vertcorner;
+    int px, py, pending;    /* newest pointer position, not applied yet */
+    unsigned long long due; /* ns, when the next update may go out */
+    unsigned long long rtt; /* ns, smoothed time an update takes */
+    unsigned int updates;   /* every DRAGPROBE-th measures rtt */
+    int mode;               /* DragLive, DragOutline or DragHybrid */
+    int gx, gy, gw, gh;     /* geometry the outline shows */
+    int outlined;           /* the client is not at gx, gy, gw, gh yet */
+    unsigned long long settle; /* ns, when a resting hybrid drag resizes */
+} Drag;
+
+typedef struct {
+    int x, y;               /* root coordinates, from the last event with them */
+    Window win;             /* top level window under it, None for the root */
+    int moved;              /* raw motion since, x and y are stale */
+    int lost;               /* win is stale too */
+} Pointer;
+
 typedef struct {
     int type;
     unsigned int mod;
@@ -152,6 +213,24 @@ typedef struct {
     const Arg arg;
 } Keychord;
 
+typedef struct {
+    KeyCode code;
+    unsigned int mod;       /* AnyModifier grabs all combinations */
+} KeyGrab;
+
+typedef struct KeyNode KeyNode;
+struct KeyNode {
+    int type;
+    unsigned int mod;       /* cleaned */
+    KeySym keysym;
+    const Keychord *chord;  /* bound to the keys up to here */
+    KeyNode **kids;         /* hash of the next keys, size a power of two */
+    unsigned int nkids, size;
+    KeyNode *next;          /* in the parent's bucket */
+    KeyGrab *grabs;         /* keys that can follow, sorted */
+    unsigned int ngrabs;
+};
+
 typedef struct {
     const char * sig;
     void (*func)(const Arg *);
@@ -163,6 +242,13 @@ typedef struct {
 } Layout;
 
 #define MAXTABS 50
+#define MAXREGIONS 16
+
+typedef struct {
+    int x0, x1;         /* [x0, x1) in bar coordinates */
+    unsigned int click;
+    unsigned int arg;   /* tag index for ClkTagBar */
+} BarRegion;
 
 typedef struct Pertag Pertag;
 struct Monitor {
@@ -173,6 +259,7 @@ struct Monitor {
     int by;               /* bar geometry */
     int ty;               /* tab bar geometry */
     int mx, my, mw, mh;   /* screen size */
+    int mmw, mmh;         /* physical size in mm, 0 if unknown */
     int wx, wy, ww, wh;   /* window area  */
     int gappih;           /* horizontal gap between windows */
     int gappiv;           /* vertical gap between windows */
@@ -201,7 +288,17 @@ struct Monitor {
     Window tagwin;
     int ntabs;
     int tab_widths[MAXTABS];
+    BarRegion regions[MAXREGIONS]; /* left to right, as drawbar drew them */
+    int nregions;
+    int hoverx0, hoverx1; /* region under the pointer, for preview hover */
     Pixmap tagmap[9];
+    Pixmap tagsnap[9]; /* unscaled captures waiting for idle time */
+    unsigned short *tagcold[9]; /* evicted previews as RGB565 */
+    unsigned long tagused[9]; /* preview LRU stamps */
+    unsigned int tagvalid; /* tags whose preview nothing has damaged since */
+    unsigned long long frametime; /* ns between refreshes, paces drags */
+    Atom name;            /* of the RandR monitor, None with Xinerama */
+    int dirty;            /* updategeom changed it */
     const Layout *lt[2];
     Pertag *pertag;
 };
@@ -220,6 +317,7 @@ typedef struct {
     int noswallow;
     int monitor;
     const char scratchkey;
+    int dragmode;
 } Rule;
 
 typedef struct {
@@ -240,6 +338,11 @@ typedef struct {
     float mfact;
 } TagRule;
 
+typedef struct {
+    unsigned long long t;
+    unsigned long req, rt;
+} ProfMark;
+
 typedef struct Systray   Systray;
 struct Systray {
     Window win;
@@ -247,6 +350,8 @@ struct Systray {
 };
 
 /* function declarations */
+static void addregion(Monitor *m, int x0, int x1, unsigned int click, unsigned int arg);
+static void applygeom(void);
 static void applyrules(Client *c);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
@@ -255,16 +360,24 @@ static void attach(Client *c);
 static void attachBelow(Client *c);
 static void attachstack(Client *c);
 static int fake_signal(void);
+static BarRegion *barregion(Monitor *m, int x);
+static KeyNode *addkeychild(KeyNode *n, const Key *key);
+static void buildkeytrie(void);
 static void buttonpress(XEvent *e);
+static void buttonrelease(XEvent *e);
+static int capturetag(void);
 static void checkotherwm(void);
 static void cleanup(void);
 static void cleanupmon(Monitor *mon);
 static void clientmessage(XEvent *e);
 static void configure(Client *c);
 static void configurenotify(XEvent *e);
+static void composepreview(Monitor *m, int tag);
 static void configurerequest(XEvent *e);
+static void configuresync(Client *c, XWindowChanges *wc, int sync);
 static Monitor *createmon(void);
 static void cyclelayout(const Arg *arg);
+static void damagenotify(XEvent *e);
 static void destroynotify(XEvent *e);
 static void detach(Client *c);
 static void detachstack(Client *c);
@@ -274,6 +387,13 @@ static void drawbars(void);
 static int drawstatusbar(Monitor *m, int bh, char* text);
 static void drawtab(Monitor *m);
 static void drawtabs(void);
+static void dragabort(void);
+static void dragend(void);
+static void dragmotion(XMotionEvent *ev);
+static void dragsettle(void);
+static void dragupdate(void);
+static void dumpprofile(const Arg *arg);
+static void dumptrace(const Arg *arg);
 static void expose(XEvent *e);
 static Client *findbefore(Client *c);
 static void focus(Client *c);
@@ -281,6 +401,8 @@ static void focusin(XEvent *e);
 static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
 static void focuswin(const Arg* arg);
+static void freepreviews(Monitor *m);
+static void freeshmimage(XImage **img, XShmSegmentInfo *si);
 static Atom getatomprop(Client *c, Atom prop, Atom req);
 static Client *getclientundermouse(void);
 static int getrootptr(int *x, int *y);
@@ -289,8 +411,14 @@ static unsigned int getsystraywidth();
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
 static void goback(const Arg *arg);
 static void grabbuttons(Client *c, int focused);
+static void freekeytrie(KeyNode *n);
 static void grabkeys(void);
+static void grabkeystep(KeyNode *prev, KeyNode *n);
 static void incnmaster(const Arg *arg);
+static KeyNode *keychild(KeyNode *n, int type, unsigned int mod, KeySym keysym);
+static unsigned long long nextdeadline(void);
+static KeyCode keycodeof(KeySym keysym);
+static int keygrabcmp(const void *a, const void *b);
 static void keypress(XEvent *e);
 static void killclient(const Arg *arg);
 static void killpermanent(const Arg *arg);
@@ -304,7 +432,10 @@ static void movemouse(const Arg *arg);
 static void movecenter(const Arg *arg);
 static unsigned int nexttag(int prev, int empty);
 static Client *nexttiled(Client *c);
+static int packpreview(Monitor *m, int i);
 static void pop(Client *);
+static void profbegin(ProfMark *pm);
+static void profend(Hist *h, const ProfMark *pm);
 static Client *prevtiled(Client *c);
 static void propertynotify(XEvent *e);
 static void pushdown(const Arg *arg);
@@ -322,7 +453,10 @@ static void resizebarwin(Monitor *m);
 static void resizeclient(Client *c, int x, int y, int w, int h);
 static void resizemouse(const Arg *arg);
 static void resizerequest(XEvent *e);
+static void resetchord(void);
+static void runtimers(void);
 static void restack(Monitor *m);
+static void rrnotify(XEvent *e);
 static void run(void);
 static void scan(void);
 static int sendevent(Window w, Atom proto, int m, long d0, long d1, long d2, long d3, long d4);
@@ -334,11 +468,17 @@ static void setdesktopnames(void);
 static void setfocus(Client *c);
 static void setfullscreen(Client *c, int fullscreen);
 static void setlayout(const Arg *arg);
+static void syncdone(Client *c, int drawn);
+static void syncdrop(Client *c);
+static void syncnotify(XEvent *e);
+static int syncpointer(void);
+static void setoutline(int x, int y, int w, int h, int b);
 static void setcfact(const Arg *arg);
 static void setmfact(const Arg *arg);
 static void setscratch(const Arg *arg);
 static void setnumdesktops(void);
 static void setup(void);
+static int shmimage(XImage **img, XShmSegmentInfo *si, int w, int h);
 static void setviewport(void);
 static void seturgent(Client *c, int urg);
 static void showhide(Client *c);
@@ -346,7 +486,9 @@ static void showtagpreview(int tag);
 static void sigchld(int unused);
 static void sighup(int unused);
 static void sigterm(int unused);
+static void sigusr1(int unused);
 static void spawn(const Arg *arg);
+static void snaptags(Monitor *m, unsigned int tagmask);
 static void switchtag(void);
 static void spawnscratch(const Arg *arg);
 static void switchcol(const Arg *arg);
@@ -382,21 +524,31 @@ static void togglefullscr(const Arg *arg);
 static void togglesticky(const Arg *arg);
 static void toggletag(const Arg *arg);
 static void toggleview(const Arg *arg);
+static void trimpreviews(void);
+static size_t snapbytes(void);
 static void togglevacant(const Arg *arg);
 static void toggletopbar(const Arg *arg);
 static void togglepadding(const Arg *arg);
 static void togglepreview(const Arg *arg);
+static void toggleprofile(const Arg *arg);
+static void toggletrace(const Arg *arg);
+static void trackpointer(XEvent *e);
 static void transfer(const Arg *arg);
 static void unfocus(Client *c, int setfocus);
 static void unmanage(Client *c, int destroyed);
+static void unpackpreview(Monitor *m, int i);
 static void unmapnotify(XEvent *e);
 static void updatecurrentdesktop(void);
 static void updatebarpos(Monitor *m);
 static void updatebars(void);
 static void updateclientlist(void);
 static int updategeom(void);
+static int updatemonitors(XRRMonitorInfo *info, int n);
 static void updatemotifhints(Client *c);
-static void updatenumlockmask(void);
+static void updatekeygrabs(KeyNode *n);
+static void updatesync(Client *c);
+static void updaterefresh(void);
+static void updatekeymap(void);
 static void updatesizehints(Client *c);
 static void updatestatus(void);
 static void updatesystray(void);
@@ -407,7 +559,9 @@ static void updatepreview(void);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
 static void view(const Arg *arg);
+static int waitevent(unsigned long long deadline);
 static void warp(const Client *c);
+static void warppointer(const Client *c, int x, int y);
 static void viewnextempty(const Arg *arg);
 static void viewprevempty(const Arg *arg);
 static void viewnext(const Arg *arg);
@@ -418,6 +572,7 @@ static void winview(const Arg* arg);
 static Client *wintosystrayicon(Window w);
 static int xerror(Display *dpy, XErrorEvent *ee);
 static int xerrordummy(Display *dpy, XErrorEvent *ee);
+static int xerrorshm(Display *dpy, XErrorEvent *ee);
 static int xerrorstart(Display *dpy, XErrorEvent *ee);
 static void zoom(const Arg *arg);
 static void focusmaster(const Arg *arg);
@@ -440,8 +595,10 @@ static int th = 0;           /* tab bar geometry */
 static int lrpad;            /* sum of left and right padding for text */
 static int (*xerrorxlib)(Display *, XErrorEvent *);
 static unsigned int numlockmask = 0;
+static KeySym keysyms[256][KEYLEVELS]; /* by keycode, see updatekeymap */
 static void (*handler[LASTEvent]) (XEvent *) = {
     [ButtonPress] = buttonpress,
+    [ButtonRelease] = buttonrelease,
     [ClientMessage] = clientmessage,
     [ConfigureRequest] = configurerequest,
     [ConfigureNotify] = configurenotify,
@@ -457,27 +614,140 @@ static void (*handler[LASTEvent]) (XEvent *) = {
     [ResizeRequest] = resizerequest,
     [UnmapNotify] = unmapnotify
 };
-static Atom wmatom[WMLast], netatom[NetLast], motifatom, xatom[XLast], clientatom[ClientLast];
+static Atom wmatom[WMLast], netatom[NetLast], motifatom, fsignalatom, xatom[XLast], clientatom[ClientLast];
+static Hist evhist[LASTEvent] = {
+    [ButtonPress] = { "ButtonPress" },
+    [ButtonRelease] = { "ButtonRelease" },
+    [ClientMessage] = { "ClientMessage" },
+    [ConfigureRequest] = { "ConfigureRequest" },
+    [ConfigureNotify] = { "ConfigureNotify" },
+    [DestroyNotify] = { "DestroyNotify" },
+    [Expose] = { "Expose" },
+    [FocusIn] = { "FocusIn" },
+    [KeyPress] = { "KeyPress" },
+    [KeyRelease] = { "KeyRelease" },
+    [MappingNotify] = { "MappingNotify" },
+    [MapRequest] = { "MapRequest" },
+    [MotionNotify] = { "MotionNotify" },
+    [PropertyNotify] = { "PropertyNotify" },
+    [ResizeRequest] = { "ResizeRequest" },
+    [UnmapNotify] = { "UnmapNotify" }
+};
+static Hist profhist[ProfLast] = {
+    [ProfArrange] = { "arrange" },
+    [ProfDrawbar] = { "drawbar" },
+    [ProfDrawtab] = { "drawtab" },
+    [ProfManage] = { "manage" },
+    [ProfSwitchtag] = { "switchtag" },
+    [ProfCapturetag] = { "capturetag" },
+    [ProfFocus] = { "focus" }
+};
+static volatile sig_atomic_t profdump = 0;
 static int restart = 0;
 static int running = 1;
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
 static Drw *drw;
+static GC snapgc;
+static int usedamage;
+static int damageevent;
+static unsigned long previewclock;
+static int useshm, shmfailed, livepreview;
+static int randr; /* XRandR 1.2, for the monitors' refresh rates */
+static int randr15, rrevent; /* XRandR 1.5, whose monitors replace Xinerama */
+static int geomdirty; /* monitors changed since the last applygeom */
+static int xiopcode; /* XInput2, for raw motion when rawmotion is set */
+static int usesync, syncevent; /* the XSync extension, for _NET_WM_SYNC_REQUEST */
+static int syncwaits; /* clients that have not drawn their sync request yet */
+static XShmSegmentInfo snapshm, thumbshm;
+static XImage *snapimg, *thumbimg;
 static Monitor *mons, *selmon, *prevmon;
+static KeyNode keytrie; /* its kids are the first keys of all keychords */
+static KeyNode *keystate = &keytrie; /* the keychord typed so far */
+static Drag drag; /* the move or resize the pointer is doing */
+static Pointer ptr = { .lost = 1 }; /* where the events dwm saw put the pointer */
+static Window outline[4]; /* edges of the outline drags show, made on first use */
+static unsigned long long chorddeadline = 0; /* ns, 0 while no chord times out */
 static Window root, wmcheckwin;
-unsigned int currentkey = 0;
 
 static xcb_connection_t *xcon;
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
 
-unsigned int tagw[LENGTH(tags)];
 
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
+void
+addregion(Monitor *m, int x0, int x1, unsigned int click, unsigned int arg)
+{
+    if (m->nregions < LENGTH(m->regions) && x0 < x1)
+        m->regions[m->nregions++] = (BarRegion) { x0, x1, click, arg };
+}
+
+KeyNode *
+addkeychild(KeyNode *n, const Key *key)
+{
+    KeyNode *k, **kids;
+    unsigned int i, h, size, mod = CLEANMASK(key->mod);
+
+    if ((k = keychild(n, key->type, mod, key->keysym)))
+        return k;
+    if (2 * (n->nkids + 1) > n->size) {
+        size = n->size ? 2 * n->size : 4;
+        kids = ecalloc(size, sizeof(KeyNode *));
+        for (i = 0; i < n->size; i++)
+            while ((k = n->kids[i])) {
+                n->kids[i] = k->next;
+                h = KEYHASH(k->type, k->mod, k->keysym) & (size - 1);
+                k->next = kids[h];
+                kids[h] = k;
+            }
+        free(n->kids);
+        n->kids = kids;
+        n->size = size;
+    }
+    k = ecalloc(1, sizeof(KeyNode));
+    k->type = key->type;
+    k->mod = mod;
+    k->keysym = key->keysym;
+    h = KEYHASH(k->type, k->mod, k->keysym) & (n->size - 1);
+    k->next = n->kids[h];
+    n->kids[h] = k;
+    n->nkids++;
+    return k;
+}
+
+/* Follows what changed in the last burst of RandR and root ConfigureNotify
+ * events: only the monitors updategeom marked dirty get their bars moved
+ * and their clients arranged. */
+void
+applygeom(void)
+{
+    Monitor *m;
+    Client *c;
+
+    geomdirty = 0;
+    drw_resize(drw, sw, bh);
+    if (!updategeom())
+        return;
+    updatebars();
+    for (m = mons; m; m = m->next) {
+        if (!m->dirty)
+            continue;
+        for (c = m->clients; c; c = c->next)
+            if (c->isfullscreen)
+                resizeclient(c, m->mx, m->my, m->mw, m->mh);
+        resizebarwin(m);
+    }
+    focus(NULL);
+    for (m = mons; m; m = m->next)
+        if (m->dirty)
+            arrange(m);
+}
+
 void
 applyrules(Client *c)
 {
@@ -493,6 +763,7 @@ applyrules(Client *c)
     c->isfloating = 0;
     c->tags = 0;
     c->scratchkey = 0;
+    c->dragmode = DragDefault;
     XGetClassHint(dpy, c->win, &ch);
     class    = ch.res_class ? ch.res_class : broken;
     instance = ch.res_name  ? ch.res_name  : broken;
@@ -515,6 +786,8 @@ applyrules(Client *c)
             c->ispermanent = r->ispermanent;
             c->tags |= r->tags;
             c->scratchkey = r->scratchkey;
+            if (r->dragmode)
+                c->dragmode = r->dragmode;
 
             if (!c->scratchkey && selmon->restart)
                 c->scratchkey = getatomprop(c, clientatom[Scratchkey], AnyPropertyType);
@@ -629,6 +902,9 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 void
 arrange(Monitor *m)
 {
+    PROFBEGIN();
+    TRACEBEGIN("arrange");
+
     if (m)
         showhide(m->stack);
     else for (m = mons; m; m = m->next)
@@ -638,6 +914,8 @@ arrange(Monitor *m)
         restack(m);
     } else for (m = mons; m; m = m->next)
         arrangemon(m);
+    TRACEEND("arrange");
+    PROFEND(ProfArrange);
 }
 
 void
@@ -645,8 +923,11 @@ arrangemon(Monitor *m) {
     updatebarpos(m);
     XMoveResizeWindow(dpy, m->tabwin, m->wx, m->ty, m->ww, th);
     strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
-    if (m->lt[m->sellt]->arrange)
+    if (m->lt[m->sellt]->arrange) {
+        TRACEBEGIN(m->lt[m->sellt]->symbol);
         m->lt[m->sellt]->arrange(m);
+        TRACEEND(m->lt[m->sellt]->symbol);
+    }
 }
 
 void
@@ -695,10 +976,26 @@ swallow(Client *p, Client *c)
 
     p->swallowing = c;
     c->mon = p->mon;
+    /* the alarms trade windows, what they were waiting for is moot */
+    syncdrop(p);
+    syncdrop(c);
 
     Window w = p->win;
     p->win = c->win;
     c->win = w;
+    int g = p->grabstate;
+    p->grabstate = c->grabstate;
+    c->grabstate = g;
+    XSyncAlarm a = p->syncalarm;
+    p->syncalarm = c->syncalarm;
+    c->syncalarm = a;
+    unsigned long long v = p->syncvalue;
+    p->syncvalue = c->syncvalue;
+    c->syncvalue = v;
+    Damage d = p->damage;
+    p->damage = c->damage;
+    c->damage = d;
+    p->syncw = p->synch = 0;
     updatetitle(p);
     XMoveResizeWindow(dpy, p->win, p->x, p->y, p->w, p->h);
     arrange(p->mon);
@@ -709,7 +1006,13 @@ swallow(Client *p, Client *c)
 void
 unswallow(Client *c)
 {
+    syncdrop(c);
     c->win = c->swallowing->win;
+    c->grabstate = c->swallowing->grabstate;
+    c->syncalarm = c->swallowing->syncalarm;
+    c->syncvalue = c->swallowing->syncvalue;
+    c->damage = c->swallowing->damage;
+    c->syncw = c->synch = 0;
 
     free(c->swallowing);
     c->swallowing = NULL;
@@ -725,15 +1028,56 @@ unswallow(Client *c)
     arrange(c->mon);
 }
 
+/* the region of m's bar containing x, the table is sorted by drawbar */
+BarRegion *
+barregion(Monitor *m, int x)
+{
+    int lo = 0, hi = m->nregions - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (x < m->regions[mid].x0)
+            hi = mid - 1;
+        else if (x >= m->regions[mid].x1)
+            lo = mid + 1;
+        else
+            return &m->regions[mid];
+    }
+    return NULL;
+}
+
+/* Compiles keychords[] into a trie with one level per chord step. A chord
+ * that is a prefix of another shadows it, as the first match runs; of two
+ * identical chords the first one wins. */
+void
+buildkeytrie(void)
+{
+    unsigned int i, j;
+    KeyNode *n;
+
+    for (i = 0; i < LENGTH(keychords); i++) {
+        if (!keychords[i]->func)
+            continue;
+        for (n = &keytrie, j = 0; j < keychords[i]->n; j++)
+            n = addkeychild(n, &keychords[i]->keys[j]);
+        if (!n->chord)
+            n->chord = keychords[i];
+    }
+}
+
 void
 buttonpress(XEvent *e)
 {
-    unsigned int i, x, click, occ = 0, n = 0;
+    unsigned int i, x, click;
     Arg arg = {0};
     Client *c;
     Monitor *m;
+    BarRegion *r;
     XButtonPressedEvent *ev = &e->xbutton;
 
+    /* other buttons do nothing until a drag is over */
+    if (drag.c)
+        return;
     click = ClkRootWin;
 
     /* focus monitor if necessary */
@@ -745,51 +1089,17 @@ buttonpress(XEvent *e)
         selmon = m;
         focus(NULL);
     }
-    for (c = selmon->clients; c; c = c->next)
-        if (ISVISIBLE(c))
-            n++;
 
     if (ev->window == selmon->barwin) {
         if (selmon->previewshow) {
             XUnmapWindow(dpy, selmon->tagwin);
             selmon->previewshow = 0;
+            selmon->hoverx0 = selmon->hoverx1 = 0;
         }
-        i = 0;
-        x = LENGTH(selmon->ltsymbol) + blw - 15;
-
-        if (selmon->vactag) {
-            for (c = selmon->clients; c; c = c->next)
-                occ |= c->tags == 255 ? 0 : c->tags;
-            do {
-                /* do not reserve space for vacant tags */
-                if (!(occ & 1 << i || selmon->tagset[selmon->seltags] & 1 << i))
-                    continue;
-                x += tagw[i];
-            } while (ev->x >= x && ++i < LENGTH(tags));
-
-            if (ev->x < LENGTH(selmon->ltsymbol) + blw) {
-                click = ClkLtSymbol;
-            } else if (i < LENGTH(tags)) {
-                click = ClkTagBar;
-                arg.ui = 1 << i;
-            } else if (ev->x < x - 20 + blw && n > 1) {
-                click = ClkNumSymbol;
-            } else
-                click = ClkStatusText;
-        } else {
-            do
-                x += tagw[i];
-            while (ev->x >= x && ++i < LENGTH(tags));
-
-            if (ev->x < LENGTH(selmon->ltsymbol) + blw) {
-                click = ClkLtSymbol;
-            } else if (i < LENGTH(tags)) {
-                click = ClkTagBar;
-                arg.ui = 1 << i;
-            } else if (ev->x < x - 5 + blw && n > 1) {
-                click = ClkNumSymbol;
-            } else
-                click = ClkStatusText;
+        if ((r = barregion(selmon, ev->x))) {
+            click = r->click;
+            if (click == ClkTagBar)
+                arg.ui = 1 << r->arg;
         }
     }
     if (ev->window == selmon->tabwin) {
@@ -811,7 +1121,13 @@ buttonpress(XEvent *e)
     else if ((c = wintoclient(ev->window))) {
         if (focusonwheel || (ev->button != Button4 && ev->button != Button5))
             focus(c);
-        XAllowEvents(dpy, ReplayPointer, CurrentTime);
+        for (i = 0; i < LENGTH(buttons); i++)
+            if (buttons[i].click == ClkClientWin && buttons[i].func && buttons[i].button == ev->button
+            && CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
+                break;
+        /* unfocused clients only have the catch-all grab, a bound click
+         * is not passed on to them */
+        XAllowEvents(dpy, i < LENGTH(buttons) ? AsyncPointer : ReplayPointer, CurrentTime);
         click = ClkClientWin;
     }
     for (i = 0; i < LENGTH(buttons); i++)
@@ -821,6 +1137,13 @@ buttonpress(XEvent *e)
         }
 }
 
+void
+buttonrelease(XEvent *e)
+{
+    if (drag.c)
+        dragend();
+}
+
 void
 checkotherwm(void)
 {
@@ -846,6 +1169,7 @@ cleanup(void)
         while (m->stack)
             unmanage(m->stack, 0);
     XUngrabKey(dpy, AnyKey, AnyModifier, root);
+    freekeytrie(&keytrie);
     while (mons)
         cleanupmon(mons);
     if (showsystray) {
@@ -859,6 +1183,14 @@ cleanup(void)
         free(scheme[i]);
      free(scheme);
     XDestroyWindow(dpy, wmcheckwin);
+    for (i = 0; i < LENGTH(outline); i++)
+        if (outline[i])
+            XDestroyWindow(dpy, outline[i]);
+    XFreeGC(dpy, snapgc);
+    if (livepreview)
+        XCompositeUnredirectSubwindows(dpy, root, CompositeRedirectAutomatic);
+    freeshmimage(&snapimg, &snapshm);
+    freeshmimage(&thumbimg, &thumbshm);
     drw_free(drw);
     XSync(dpy, False);
     XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
@@ -869,7 +1201,6 @@ void
 cleanupmon(Monitor *mon)
 {
     Monitor *m;
-    size_t i;
 
     if (mon == mons)
         mons = mons->next;
@@ -877,9 +1208,7 @@ cleanupmon(Monitor *mon)
         for (m = mons; m && m->next != mon; m = m->next);
         m->next = mon->next;
     }
-    for (i = 0; i < LENGTH(tags); i++)
-        if (mon->tagmap[i])
-            XFreePixmap(dpy, mon->tagmap[i]);
+    freepreviews(mon);
     XUnmapWindow(dpy, mon->barwin);
     XDestroyWindow(dpy, mon->barwin);
     XUnmapWindow(dpy, mon->tabwin);
@@ -994,31 +1323,71 @@ configure(Client *c)
 void
 configurenotify(XEvent *e)
 {
-    Monitor *m;
-    Client *c;
     XConfigureEvent *ev = &e->xconfigure;
-    int dirty;
 
-    /* TODO: updategeom handling sucks, needs to be simplified */
+    /* applied with the RandR events of the same change, see applygeom */
     if (ev->window == root) {
-        dirty = (sw != ev->width || sh != ev->height);
         sw = ev->width;
         sh = ev->height;
-        if (updategeom() || dirty) {
-            drw_resize(drw, sw, bh);
-            updatebars();
-            for (m = mons; m; m = m->next) {
-                for (c = m->clients; c; c = c->next)
-                    if (c->isfullscreen)
-                        resizeclient(c, m->mx, m->my, m->mw, m->mh);
-                resizebarwin(m);
-            }
-            focus(NULL);
-            arrange(NULL);
-        }
+        geomdirty = 1;
     }
 }
 
+/* Draws the tag's windows from their composite pixmaps, scaled by XRender
+ * on the server, where the last arrange of that tag left them. */
+void
+composepreview(Monitor *m, int tag)
+{
+    int pass, f = scalepreview;
+    Client *c, *end;
+    Pixmap pix;
+    Picture src, dst;
+    XTransform xf = {{
+        { XDoubleToFixed(f), 0, 0 },
+        { 0, XDoubleToFixed(f), 0 },
+        { 0, 0, XDoubleToFixed(1) }
+    }};
+
+    for (c = m->clients; c && !(c->tags & 1 << tag); c = c->next);
+    if (!c) {
+        if (m->tagmap[tag])
+            XFreePixmap(dpy, m->tagmap[tag]);
+        m->tagmap[tag] = 0;
+        return;
+    }
+
+    PROFBEGIN();
+    if (!m->tagmap[tag])
+        m->tagmap[tag] = XCreatePixmap(dpy, m->tagwin, m->mw / f, m->mh / f, DefaultDepth(dpy, screen));
+    XSetForeground(dpy, drw->gc, scheme[SchemeNorm][ColBg].pixel);
+    XFillRectangle(dpy, m->tagmap[tag], drw->gc, 0, 0, m->mw / f, m->mh / f);
+    dst = XRenderCreatePicture(dpy, m->tagmap[tag],
+        XRenderFindVisualFormat(dpy, DefaultVisual(dpy, screen)), 0, NULL);
+    /* a window that is gone or unmapped only fails its own requests */
+    XSetErrorHandler(xerrordummy);
+    /* tiled windows first, then the floating ones, each bottom of the stack up */
+    for (pass = 0; pass < 2; pass++)
+        for (end = NULL; end != m->stack; end = c) {
+            for (c = m->stack; c->snext != end; c = c->snext);
+            if (!(c->tags & 1 << tag) || !c->isfloating != !pass || !c->format)
+                continue;
+            pix = XCompositeNameWindowPixmap(dpy, c->win);
+            src = XRenderCreatePicture(dpy, pix, c->format, 0, NULL);
+            XRenderSetPictureTransform(dpy, src, &xf);
+            XRenderSetPictureFilter(dpy, src, FilterBilinear, NULL, 0);
+            XRenderComposite(dpy, PictOpOver, src, None, dst, 0, 0, 0, 0,
+                (c->x - m->wx) / f, (c->y - m->wy) / f, WIDTH(c) / f, HEIGHT(c) / f);
+            XRenderFreePicture(dpy, src);
+            XFreePixmap(dpy, pix);
+        }
+    XRenderFreePicture(dpy, dst);
+    XSync(dpy, False);
+    XSetErrorHandler(xerror);
+    m->tagused[tag] = ++previewclock;
+    trimpreviews();
+    PROFEND(ProfCapturetag);
+}
+
 void
 configurerequest(XEvent *e)
 {
@@ -1075,6 +1444,31 @@ configurerequest(XEvent *e)
     XSync(dpy, False);
 }
 
+/* Configures c to wc. With sync set, a client that takes sync requests is
+ * first asked to report when it has drawn a new size, and resizeclient
+ * holds back its configures until it has. */
+void
+configuresync(Client *c, XWindowChanges *wc, int sync)
+{
+    XSyncValue v;
+
+    if (sync && c->syncalarm && (wc->width != c->syncw || wc->height != c->synch)) {
+        c->syncvalue++;
+        XSyncIntsToValue(&v, c->syncvalue & 0xffffffff, c->syncvalue >> 32);
+        XSyncChangeAlarm(dpy, c->syncalarm, XSyncCAValue,
+            &((XSyncAlarmAttributes) { .trigger.wait_value = v }));
+        sendevent(c->win, wmatom[WMProtocols], NoEventMask, netatom[NetWMSyncRequest],
+            CurrentTime, c->syncvalue & 0xffffffff, c->syncvalue >> 32, 0);
+        c->syncw = wc->width;
+        c->synch = wc->height;
+        c->syncwait = 1;
+        c->syncdue = prof_now() + syncrequesttimeout * 1000000ULL;
+        syncwaits++;
+    }
+    XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, wc);
+    configure(c);
+}
+
 Monitor *
 createmon(void)
 {
@@ -1194,6 +1588,26 @@ cyclelayout(const Arg *arg) {
     }
 }
 
+/* Drops the validity of the previews a client drew on, unless it is only
+ * redrawing what showhide just brought back into view. The damage stays
+ * until snaptags captures the client again, so it reports once. */
+void
+damagenotify(XEvent *e)
+{
+    XDamageNotifyEvent *ev = (XDamageNotifyEvent *)e;
+    Client *c;
+    Monitor *m;
+
+    if (!(c = wintoclient(ev->drawable)))
+        return;
+    if (prof_now() - c->exposed < previewsettle * 1000000ULL) {
+        XDamageSubtract(dpy, c->damage, None, None);
+        return;
+    }
+    m = c->mon;
+    m->tagvalid &= ~(ISVISIBLE(c) ? m->tagset[m->seltags] : c->tags);
+}
+
 void
 destroynotify(XEvent *e)
 {
@@ -1255,6 +1669,7 @@ drawstatusbar(Monitor *m, int bh, char* stext) {
     char *text;
     char *p;
 
+    TRACEBEGIN("drawstatusbar");
     len = strlen(stext) + 1 ;
     if (!(text = (char*) malloc(sizeof(char)*len)))
         die("malloc");
@@ -1353,6 +1768,7 @@ drawstatusbar(Monitor *m, int bh, char* stext) {
 
     drw_setscheme(drw, scheme[SchemeNorm]);
     free(p);
+    TRACEEND("drawstatusbar");
 
     return ret;
 }
@@ -1376,6 +1792,10 @@ drawbar(Monitor *m)
     if (!m->showbar)
         return;
 
+    PROFBEGIN();
+    TRACEBEGIN("drawbar");
+    m->nregions = 0;
+    m->hoverx0 = m->hoverx1 = 0;
     for (i = 0; i < LENGTH(tags); i++)
         masterclientontag[i] = NULL;
 
@@ -1401,6 +1821,7 @@ drawbar(Monitor *m)
     w = blw = TEXTW(m->ltsymbol);
     drw_setscheme(drw, scheme[m == selmon ? SchemeLtsymbol : SchemeInvLtsymbol]);
     x = drw_text(drw, 0, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+    addregion(m, 0, x, ClkLtSymbol, 0);
 
     for (i = 0; i < LENGTH(tags); i++) {
         indn = 0;
@@ -1414,7 +1835,7 @@ drawbar(Monitor *m)
         else
             snprintf(tagdisp, 24, etagf, tags[i]);
         masterclientontag[i] = tagdisp;
-        tagw[i] = w = TEXTW(masterclientontag[i]);
+        w = TEXTW(masterclientontag[i]);
         if (m->vactag) {
             if (occ & 1 << i)
                 drw_setscheme(drw, scheme[m == selmon ? m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm : SchemeInv]);
@@ -1442,6 +1863,7 @@ drawbar(Monitor *m)
                 indn++;
             }
 
+        addregion(m, x, x + w, ClkTagBar, i);
         x += w;
     }
 
@@ -1449,13 +1871,18 @@ drawbar(Monitor *m)
         drw_setscheme(drw, scheme[SchemeClientNum]);
         snprintf(ntext, sizeof ntext, " {%u}", n);
         w = TEXTW(ntext);
+        addregion(m, x, x + w, ClkNumSymbol, 0);
         x = drw_text(drw, x, 0, w, bh, lrpad / 2, ntext, 0);
     }
+    /* clicks on the empty middle of the bar count as status text too */
+    addregion(m, x, m->ww, ClkStatusText, 0);
 
     drw_setscheme(drw, scheme[SchemeStatus]);
     drw_rect(drw, x, 0, m->ww - x, bh, 1, 1);
     drawstatusbar(m, bh, stext);
     drw_map(drw, m->barwin, 0, 0, m->ww - stw, bh);
+    TRACEEND("drawbar");
+    PROFEND(ProfDrawbar);
 }
 
 void
@@ -1475,6 +1902,157 @@ drawtabs(void) {
         drawtab(m);
 }
 
+/* ends the drag on button release and moves the client to the monitor it
+ * was dropped on */
+/* drops the drag without moving the client any further */
+void
+dragabort(void)
+{
+    drag.c = NULL;
+    drag.pending = drag.outlined = 0;
+    drag.settle = 0;
+    setoutline(0, 0, 0, 0, 0);
+    XUngrabPointer(dpy, CurrentTime);
+}
+
+void
+dragend(void)
+{
+    Client *c = drag.c;
+    Monitor *m;
+    XEvent ev;
+
+    if (!ISVISIBLE(c)) {
+        dragabort();
+        return;
+    }
+    /* the drop lands where the pointer is, not where the last frame was */
+    if (drag.pending)
+        dragupdate();
+    if (drag.outlined)
+        dragsettle();
+    drag.c = NULL;
+    if (drag.resize)
+        warppointer(c, drag.horizcorner ? (-c->bw) : (c->w + c->bw - 1),
+                  drag.vertcorner ? (-c->bw) : (c->h + c->bw - 1));
+    XUngrabPointer(dpy, CurrentTime);
+    if (drag.resize)
+        while (XCheckMaskEvent(dpy, EnterWindowMask, &ev))
+            trackpointer(&ev);
+    if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
+        sendmon(c, m);
+        prevmon = selmon;
+        selmon = m;
+        focus(NULL);
+    }
+}
+
+/* Takes the newest of the queued motion events and applies it now if a
+ * frame has passed since the last update, else run() does at the due time. */
+void
+dragmotion(XMotionEvent *ev)
+{
+    XEvent next;
+
+    drag.px = ev->x;
+    drag.py = ev->y;
+    while (XPending(dpy) && (XPeekEvent(dpy, &next), next.type == MotionNotify)) {
+        XNextEvent(dpy, &next);
+        trackpointer(&next);
+        drag.px = next.xmotion.x;
+        drag.py = next.xmotion.y;
+    }
+    drag.pending = 1;
+    if (prof_now() >= drag.due)
+        dragupdate();
+}
+
+/* gives the client the geometry the outline shows and hides the outline */
+void
+dragsettle(void)
+{
+    drag.settle = 0;
+    if (!drag.outlined)
+        return;
+    if (!ISVISIBLE(drag.c)) {
+        dragabort();
+        return;
+    }
+    drag.outlined = 0;
+    setoutline(0, 0, 0, 0, 0);
+    resize(drag.c, drag.gx, drag.gy, drag.gw, drag.gh, 1);
+}
+
+/* Moves or resizes the client to the pointer. Updates are paced to the
+ * refresh rate of the client's monitor, or to twice the time an update
+ * takes to get through the server, whichever is slower. Only every
+ * DRAGPROBE-th update waits to find out, the others are just flushed. */
+void
+dragupdate(void)
+{
+    int nx, ny, nw, nh;
+    Client *c = drag.c;
+    unsigned long long t = prof_now();
+
+    drag.pending = 0;
+    /* keys still work during a drag, a view may have hidden the client */
+    if (!ISVISIBLE(c)) {
+        dragabort();
+        return;
+    }
+    if (!drag.resize) {
+        nx = drag.ocx + (drag.px - drag.x);
+        ny = drag.ocy + (drag.py - drag.y);
+        if (abs(selmon->wx - nx) < snap)
+            nx = selmon->wx;
+        else if (abs((selmon->wx + selmon->ww) - (nx + WIDTH(c))) < snap)
+            nx = selmon->wx + selmon->ww - WIDTH(c);
+        if (abs(selmon->wy - ny) < snap)
+            ny = selmon->wy;
+        else if (abs((selmon->wy + selmon->wh) - (ny + HEIGHT(c))) < snap)
+            ny = selmon->wy + selmon->wh - HEIGHT(c);
+        if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
+        && (abs(nx - c->x) > snap || abs(ny - c->y) > snap))
+            togglefloating(NULL);
+        nw = c->w;
+        nh = c->h;
+    } else {
+        nx = drag.horizcorner ? drag.px : c->x;
+        ny = drag.vertcorner ? drag.py : c->y;
+        nw = MAX(drag.horizcorner ? (drag.ocx2 - nx) : (drag.px - drag.ocx - 2 * c->bw + 1), 1);
+        nh = MAX(drag.vertcorner ? (drag.ocy2 - ny) : (drag.py - drag.ocy - 2 * c->bw + 1), 1);
+
+        if (c->mon->wx + nw >= selmon->wx && c->mon->wx + nw <= selmon->wx + selmon->ww
+        && c->mon->wy + nh >= selmon->wy && c->mon->wy + nh <= selmon->wy + selmon->wh)
+        {
+            if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
+            && (abs(nw - c->w) > snap || abs(nh - c->h) > snap))
+                togglefloating(NULL);
+        }
+    }
+    if (selmon->lt[selmon->sellt]->arrange && !c->isfloating)
+        return;
+    if (drag.mode == DragLive)
+        resize(c, nx, ny, nw, nh, 1);
+    else {
+        /* the client only sees the geometry it ends up with */
+        applysizehints(c, &nx, &ny, &nw, &nh, 1);
+        drag.gx = nx;
+        drag.gy = ny;
+        drag.gw = nw;
+        drag.gh = nh;
+        drag.outlined = 1;
+        setoutline(nx, ny, nw + 2 * c->bw, nh + 2 * c->bw, MAX(c->bw, 1));
+        if (drag.mode == DragHybrid)
+            drag.settle = prof_now() + dragpause * 1000000ULL;
+    }
+    if (drag.updates++ % DRAGPROBE == 0) {
+        XSync(dpy, False);
+        drag.rtt = (3 * drag.rtt + prof_now() - t) / 4;
+    }
+    drag.due = t + MAX(c->mon->frametime, 2 * drag.rtt);
+}
+
 static int
 cmpint(const void *p1, const void *p2) {
   /* The actual arguments to this function are "pointers to
@@ -1496,6 +2074,8 @@ drawtab(Monitor *m) {
     int maxsize = bh;
     int x = 0;
     int w = 0;
+    PROFBEGIN();
+    TRACEBEGIN("drawtab");
 
     //view_info: indicate the tag which is displayed in the view
     for(i = 0; i < LENGTH(tags); ++i){
@@ -1564,6 +2144,28 @@ drawtab(Monitor *m) {
     drw_text(drw, x, 0, w, th, 0, view_info, 0);
 
     drw_map(drw, m->tabwin, 0, 0, m->ww, th);
+    TRACEEND("drawtab");
+    PROFEND(ProfDrawtab);
+}
+
+/* arg->i selects JSON instead of a plain text table */
+void
+dumpprofile(const Arg *arg)
+{
+    if (arg->i)
+        fputs("{", stderr);
+    hist_dump(stderr, "events", evhist, LENGTH(evhist), arg->i);
+    fputs(arg->i ? "," : "\n", stderr);
+    hist_dump(stderr, "internals", profhist, LENGTH(profhist), arg->i);
+    fputs(arg->i ? "}\n" : "\n", stderr);
+    fflush(stderr);
+}
+
+void
+dumptrace(const Arg *arg)
+{
+    if (!trace_dump(tracefile))
+        fprintf(stderr, "dwm: cannot write trace to %s\n", tracefile);
 }
 
 void
@@ -1593,6 +2195,8 @@ findbefore(Client *c)
 void
 focus(Client *c)
 {
+    PROFBEGIN();
+
     if (!c || !ISVISIBLE(c))
         for (c = selmon->stack; c && !ISVISIBLE(c); c = c->snext);
     if (selmon->sel && selmon->sel != c)
@@ -1627,6 +2231,7 @@ focus(Client *c)
     selmon->sel = c;
     drawbars();
     drawtabs();
+    PROFEND(ProfFocus);
 }
 
 /* there are some broken focus acquiring clients needing extra handling */
@@ -1650,6 +2255,7 @@ focusmon(const Arg *arg)
         return;
     unfocus(selmon->sel, 0);
     XWarpPointer(dpy, None, m->barwin, 0, 0, 0, 0, m->mw / 2, m->mh / 2);
+    ptr.lost = 1;
     prevmon = selmon;
     selmon = m;
     focus(NULL);
@@ -1699,6 +2305,35 @@ focuswin(const Arg* arg) {
     }
 }
 
+void
+freepreviews(Monitor *m)
+{
+    int i;
+
+    for (i = 0; i < LENGTH(tags); i++) {
+        if (m->tagmap[i])
+            XFreePixmap(dpy, m->tagmap[i]);
+        if (m->tagsnap[i])
+            XFreePixmap(dpy, m->tagsnap[i]);
+        free(m->tagcold[i]);
+        m->tagmap[i] = m->tagsnap[i] = 0;
+        m->tagcold[i] = NULL;
+    }
+    m->tagvalid = 0;
+}
+
+void
+freeshmimage(XImage **img, XShmSegmentInfo *si)
+{
+    if (!*img)
+        return;
+    XShmDetach(dpy, si);
+    shmdt(si->shmaddr);
+    (*img)->data = NULL;
+    XDestroyImage(*img);
+    *img = NULL;
+}
+
 Atom
 getatomprop(Client *c, Atom prop, Atom req)
 {
@@ -1708,6 +2343,7 @@ getatomprop(Client *c, Atom prop, Atom req)
     Atom da, atom = None;
     /* FIXME getatomprop should return the number of items and a pointer to
      * the stored data instead of this workaround */
+    TRACEBEGIN("getatomprop");
 	if (XGetWindowProperty(dpy, c->win, prop, 0L, sizeof atom, False, req,
 		&da, &di, &dl, &dl, &p) == Success && p) {
 		atom = *(Atom *)p;
@@ -1715,31 +2351,28 @@ getatomprop(Client *c, Atom prop, Atom req)
 			atom = ((Atom *)p)[1];
 		XFree(p);
 	}
+    TRACEEND("getatomprop");
 	return atom;
 }
 
 Client *
 getclientundermouse(void)
 {
-	int ret, di;
-	unsigned int dui;
-	Window child, dummy;
-
-	ret = XQueryPointer(dpy, root, &dummy, &child, &di, &di, &di, &di, &dui);
-	if (!ret)
-		return NULL;
-
-	return wintoclient(child);
+    if (ptr.lost && !syncpointer())
+        return NULL;
+    return wintoclient(ptr.win);
 }
 
+/* where trackpointer last saw the pointer, the server is only asked when
+ * that is known to be stale */
 int
 getrootptr(int *x, int *y)
 {
-    int di;
-    unsigned int dui;
-    Window dummy;
-
-    return XQueryPointer(dpy, root, &dummy, &dummy, x, y, &di, &di, &dui);
+    if ((ptr.lost || ptr.moved) && !syncpointer())
+        return 0;
+    *x = ptr.x;
+    *y = ptr.y;
+    return 1;
 }
 
 long
@@ -1780,8 +2413,11 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
     if (!text || size == 0)
         return 0;
     text[0] = '\0';
-    if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
+    TRACEBEGIN("gettextprop");
+    if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems) {
+        TRACEEND("gettextprop");
         return 0;
+    }
     if (name.encoding == XA_STRING)
         strncpy(text, (char *)name.value, size - 1);
     else {
@@ -1792,6 +2428,7 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
     }
     text[size - 1] = '\0';
     XFree(name.value);
+    TRACEEND("gettextprop");
     return 1;
 }
 
@@ -1810,45 +2447,102 @@ goback(const Arg *arg)
     }
 }
 
+/* An unfocused client has a single catch-all grab that focuses it on any
+ * click, a focused one the ClkClientWin bindings. Nothing is sent if the
+ * client already has the grabs asked for. */
 void
 grabbuttons(Client *c, int focused)
 {
-    updatenumlockmask();
-    {
-        unsigned int i, j;
-        unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+    unsigned int i, j;
+    unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+    int state = focused ? GrabFocused : GrabUnfocused;
+
+    if (c->grabstate == state)
+        return;
+    if (c->grabstate != GrabNone)
         XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
-        if (!focused)
-            XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
-                BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
-        for (i = 0; i < LENGTH(buttons); i++)
-            if (buttons[i].click == ClkClientWin)
-                for (j = 0; j < LENGTH(modifiers); j++)
-                    XGrabButton(dpy, buttons[i].button,
-                        buttons[i].mask | modifiers[j],
-                        c->win, False, BUTTONMASK,
-                        GrabModeAsync, GrabModeSync, None, None);
+    c->grabstate = state;
+    if (!focused) {
+        XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
+            BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
+        return;
     }
+    for (i = 0; i < LENGTH(buttons); i++)
+        if (buttons[i].click == ClkClientWin)
+            for (j = 0; j < LENGTH(modifiers); j++)
+                XGrabButton(dpy, buttons[i].button,
+                    buttons[i].mask | modifiers[j],
+                    c->win, False, BUTTONMASK,
+                    GrabModeAsync, GrabModeSync, None, None);
 }
 
 void
-grabkeys(void)
+freekeytrie(KeyNode *n)
 {
-    updatenumlockmask();
-    {
-        unsigned int i, k;
-        unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
-        KeyCode code;
+    KeyNode *k;
+    unsigned int i;
 
-        XUngrabKey(dpy, AnyKey, AnyModifier, root);
-        for (i = 0; i < LENGTH(keychords); i++)
-            if ((code = XKeysymToKeycode(dpy, keychords[i]->keys[currentkey].keysym)))
-                for (k = 0; k < LENGTH(modifiers); k++)
-                    XGrabKey(dpy, code, keychords[i]->keys[currentkey].mod | modifiers[k], root,
-                             True, GrabModeAsync, GrabModeAsync);
-        if (currentkey > 0)
-            XGrabKey(dpy, XKeysymToKeycode(dpy, XK_Escape), AnyModifier, root, True, GrabModeAsync, GrabModeAsync);
-    }
+    for (i = 0; i < n->size; i++)
+        while ((k = n->kids[i])) {
+            n->kids[i] = k->next;
+            freekeytrie(k);
+            free(k);
+        }
+    free(n->kids);
+    free(n->grabs);
+    n->kids = NULL;
+    n->grabs = NULL;
+    n->nkids = n->size = n->ngrabs = 0;
+}
+
+/* Regrabs everything for the current keyboard mapping. Only setup and
+ * mappingnotify come here, chord steps go through grabkeystep. */
+void
+grabkeys(void)
+{
+    updatekeygrabs(&keytrie);
+    XUngrabKey(dpy, AnyKey, AnyModifier, root);
+    grabkeystep(NULL, keystate);
+}
+
+/* Moves the key grabs from the keys that can follow prev to those that can
+ * follow n, leaving the ones both have alone. Ungrabs go first, as ungrabbing
+ * Escape with AnyModifier would also drop a chord's own Escape grab. */
+void
+grabkeystep(KeyNode *prev, KeyNode *n)
+{
+    static const KeyNode none = { 0 };
+    unsigned int i, j, k, pass;
+    unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+    const KeyNode *p = prev ? prev : &none;
+    const KeyGrab *g;
+    unsigned char ungrabbed[256 / 8] = { 0 };
+    int d;
+
+    for (pass = 0; pass < 2; pass++)
+        for (i = j = 0; i < p->ngrabs || j < n->ngrabs;) {
+            d = i == p->ngrabs ? 1 : j == n->ngrabs ? -1
+                : keygrabcmp(&p->grabs[i], &n->grabs[j]);
+            g = d < 0 ? &p->grabs[i++] : &n->grabs[j++];
+            if (d == 0) {
+                i++;
+                /* an ungrab overlapping it on the same key, such as the
+                 * AnyModifier one of Escape, took it away too */
+                if (pass == 0 || !(ungrabbed[g->code / 8] & 1 << g->code % 8))
+                    continue;
+            } else if ((d < 0) != (pass == 0))
+                continue;
+            if (pass == 0)
+                ungrabbed[g->code / 8] |= 1 << g->code % 8;
+            for (k = 0; k < (g->mod == AnyModifier ? 1 : LENGTH(modifiers)); k++) {
+                if (pass == 0)
+                    XUngrabKey(dpy, g->code, g->mod == AnyModifier ? AnyModifier
+                        : g->mod | modifiers[k], root);
+                else
+                    XGrabKey(dpy, g->code, g->mod == AnyModifier ? AnyModifier
+                        : g->mod | modifiers[k], root, True, GrabModeAsync, GrabModeAsync);
+            }
+        }
 }
 
 void
@@ -1870,61 +2564,69 @@ isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
 }
 #endif /* XINERAMA */
 
-void
-keypress(XEvent *e)
+KeyNode *
+keychild(KeyNode *n, int type, unsigned int mod, KeySym keysym)
 {
-    XEvent event = *e;
-    unsigned int ran = 0;
-    KeySym keysym;
-    XKeyEvent *ev;
-
-    Keychord *arr1[sizeof(keychords) / sizeof(Keychord*)];
-    Keychord *arr2[sizeof(keychords) / sizeof(Keychord*)];
-    memcpy(arr1, keychords, sizeof(keychords));
-    Keychord **rpointer = arr1;
-    Keychord **wpointer = arr2;
-    
-    size_t r = sizeof(keychords)/ sizeof(Keychord*);
-    
-    while (1) {
-        ev = &event.xkey;
-        keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
-        size_t w = 0;
-
-        for (int i = 0; i < r; i++){
-            if(keysym == (*(rpointer + i))->keys[currentkey].keysym
-               && ev->type == (*(rpointer + 1))->keys[currentkey].type
-               && CLEANMASK((*(rpointer + i))->keys[currentkey].mod) == CLEANMASK(ev->state)
-               && (*(rpointer + i))->func) {
-                if((*(rpointer + i))->n == currentkey +1){
-                    (*(rpointer + i))->func(&((*(rpointer + i))->arg));
-                    ran = 1;
-            	}else{
-                    *(wpointer + w) = *(rpointer + i);
-                    w++;
-                }
-            }
-        }
+    KeyNode *k;
 
-        currentkey++;
+    if (!n->size)
+        return NULL;
+    for (k = n->kids[KEYHASH(type, mod, keysym) & (n->size - 1)]; k; k = k->next)
+        if (k->keysym == keysym && k->mod == mod && k->type == type)
+            return k;
+    return NULL;
+}
 
-        if(w == 0 || ran == 1)
-            break;
+/* the keycode producing keysym, lowest level first like XKeysymToKeycode */
+KeyCode
+keycodeof(KeySym keysym)
+{
+    unsigned int i, j;
 
-        grabkeys();
+    if (keysym == NoSymbol)
+        return 0;
+    for (j = 0; j < KEYLEVELS; j++)
+        for (i = 0; i < LENGTH(keysyms); i++)
+            if (keysyms[i][j] == keysym)
+                return i;
+    return 0;
+}
 
-        while (running && !XNextEvent(dpy, &event) && !ran)
-            if(event.type == KeyPress)
-                break;
+int
+keygrabcmp(const void *a, const void *b)
+{
+    const KeyGrab *x = a, *y = b;
 
-        r = w;
-        Keychord **holder = rpointer;
-        rpointer = wpointer;
-        wpointer = holder;
-    }
+    if (x->code != y->code)
+        return x->code < y->code ? -1 : 1;
+    return x->mod < y->mod ? -1 : x->mod > y->mod;
+}
 
-    currentkey = 0;
-    grabkeys();
+/* Advances the pending keychord by one key. Other events keep going
+ * through run() while a chord waits for its next key. */
+void
+keypress(XEvent *e)
+{
+    XKeyEvent *ev = &e->xkey;
+    KeyNode *n;
+
+    n = keychild(keystate, ev->type, CLEANMASK(ev->state),
+        keysyms[(KeyCode)ev->keycode][0]);
+    if (!n) {
+        /* releasing the keys typed so far does not end a chord */
+        if (ev->type == KeyPress)
+            resetchord();
+        return;
+    }
+    if (n->chord) {
+        resetchord();
+        n->chord->func(&n->chord->arg);
+        return;
+    }
+    grabkeystep(keystate, n);
+    keystate = n;
+    if (keychordtimeout)
+        chorddeadline = prof_now() + keychordtimeout * 1000000ULL;
 }
 
 int
@@ -1934,9 +2636,10 @@ fake_signal(void)
     char indicator[9] = "fsignal:";
     char str_sig[50];
     char param[16];
-    int i, len_str_sig, n, paramn;
+    int i, len_str_sig, n, paramn, valid = 1;
     size_t len_fsignal, len_indicator = strlen(indicator);
     Arg arg;
+    static long handled = 0;
 
     // Get root name property
     if (gettextprop(root, XA_WM_NAME, fsignal, sizeof(fsignal))) {
@@ -1947,20 +2650,25 @@ fake_signal(void)
             paramn = sscanf(fsignal+len_indicator, "%s%n%s%n", str_sig, &len_str_sig, param, &n);
 
             if (paramn == 1) arg = (Arg) {0};
-            else if (paramn > 2) return 1;
+            else if (paramn != 2) valid = 0;
             else if (strncmp(param, "i", n - len_str_sig) == 0)
                 sscanf(fsignal + len_indicator + n, "%i", &(arg.i));
             else if (strncmp(param, "ui", n - len_str_sig) == 0)
                 sscanf(fsignal + len_indicator + n, "%u", &(arg.ui));
             else if (strncmp(param, "f", n - len_str_sig) == 0)
                 sscanf(fsignal + len_indicator + n, "%f", &(arg.f));
-            else return 1;
+            else valid = 0;
 
             // Check if a signal was found, and if so handle it
-            for (i = 0; i < LENGTH(signals); i++)
+            for (i = 0; valid && i < LENGTH(signals); i++)
                 if (strncmp(str_sig, signals[i].sig, len_str_sig) == 0 && signals[i].func)
                     signals[i].func(&(arg));
 
+            // Count handled signals on the root window, so senders can wait for them,
+            // malformed ones too
+            handled++;
+            XChangeProperty(dpy, root, fsignalatom, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&handled, 1);
+
             // A fake signal was sent
             return 1;
         }
@@ -2031,6 +2739,7 @@ manage(Window w, XWindowAttributes *wa)
     Client *c, *t = NULL, *term = NULL;
     Window trans = None;
     XWindowChanges wc;
+    PROFBEGIN();
 
     c = ecalloc(1, sizeof(Client));
     c->win = w;
@@ -2041,6 +2750,8 @@ manage(Window w, XWindowAttributes *wa)
     c->w = c->oldw = wa->width;
     c->h = c->oldh = wa->height;
     c->oldbw = wa->border_width;
+    if (livepreview)
+        c->format = XRenderFindVisualFormat(dpy, wa->visual);
     c->cfact = 1.0;
 
     {
@@ -2097,6 +2808,9 @@ manage(Window w, XWindowAttributes *wa)
         setfullscreen(c, 1);
     updatesizehints(c);
     updatewmhints(c);
+    updatesync(c);
+    if (usedamage)
+        c->damage = XDamageCreate(dpy, c->win, XDamageReportNonEmpty);
     c->sfx = c->x;
     c->sfy = c->y;
     c->sfw = c->w;
@@ -2121,6 +2835,7 @@ manage(Window w, XWindowAttributes *wa)
     else
         attach(c);
     attachstack(c);
+    c->mon->tagvalid &= ~c->tags;
     XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
         (unsigned char *) &(c->win), 1);
     XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
@@ -2136,16 +2851,28 @@ manage(Window w, XWindowAttributes *wa)
     if (getatomprop(c, clientatom[IsFullscreen], AnyPropertyType)) {
         setfullscreen(c, 0);
     }
+    PROFEND(ProfManage);
 }
 
 void
 mappingnotify(XEvent *e)
 {
     XMappingEvent *ev = &e->xmapping;
+    Monitor *m;
+    Client *c;
 
     XRefreshKeyboardMapping(ev);
-    if (ev->request == MappingKeyboard)
+    if (ev->request == MappingKeyboard || ev->request == MappingModifier) {
+        updatekeymap();
         grabkeys();
+        /* the bindings were grabbed with the old numlock */
+        for (m = mons; m; m = m->next)
+            for (c = m->clients; c; c = c->next)
+                if (c->grabstate == GrabFocused) {
+                    c->grabstate = GrabStale;
+                    grabbuttons(c, 1);
+                }
+    }
 }
 
 void
@@ -2182,60 +2909,43 @@ motionnotify(XEvent *e)
 {
     static Monitor *mon = NULL;
     Monitor *m;
-    Client *c;
+    BarRegion *r;
     XMotionEvent *ev = &e->xmotion;
-    unsigned int i, x, occ = 0;
+    unsigned int i;
 
+    if (drag.c) {
+        dragmotion(ev);
+        return;
+    }
     if (showpreview) {
         if (ev->window == selmon->barwin) {
-            i = 0;
-            x = LENGTH(selmon->ltsymbol) + blw - 15;
-
-            if (selmon->vactag) {
-                for (c = selmon->clients; c; c = c->next)
-                    occ |= c->tags == 255 ? 0 : c->tags;
-                do {
-                    /* do not reserve space for vacant tags */
-                    if (!(occ & 1 << i || selmon->tagset[selmon->seltags] & 1 << i))
-                    continue;
-                        x += tagw[i];
-                } while (ev->x >= x && ++i < LENGTH(tags));
-
-                if (ev->x < LENGTH(m->ltsymbol) + blw) {
-                } else if (i < LENGTH(tags)) {
-                    if ((i + 1) != selmon->previewshow && !(selmon->tagset[selmon->seltags] & 1 << i)) {
-                        selmon->previewshow = i + 1;
-                        showtagpreview(i);
-                    } else if (selmon->tagset[selmon->seltags] & 1 << i) {
-                        selmon->previewshow = 0;
-                        showtagpreview(0);
-                    }
-                } else if (selmon->previewshow != 0) {
-                    selmon->previewshow = 0;
-                    showtagpreview(0);
-                }
-            } else {
-                do
-                    x += tagw[i];
-                while (ev->x >= x && ++i < LENGTH(tags));
-
-                if (ev->x < LENGTH(m->ltsymbol) + blw) {
-                } else if (i < LENGTH(tags)) {
-                    if ((i + 1) != selmon->previewshow && !(selmon->tagset[selmon->seltags] & 1 << i)) {
-                        selmon->previewshow = i + 1;
-                        showtagpreview(i);
-                    } else if (selmon->tagset[selmon->seltags] & 1 << i) {
-                        selmon->previewshow = 0;
-                        showtagpreview(0);
-                    }
-                } else if (selmon->previewshow != 0) {
+            /* nothing to do until the pointer leaves the region it is in */
+            if (ev->x >= selmon->hoverx0 && ev->x < selmon->hoverx1)
+                return;
+            r = barregion(selmon, ev->x);
+            selmon->hoverx0 = r ? r->x0 : 0;
+            selmon->hoverx1 = r ? r->x1 : 0;
+            if (r && r->click == ClkLtSymbol) {
+            } else if (r && r->click == ClkTagBar) {
+                i = r->arg;
+                if ((i + 1) != selmon->previewshow && !(selmon->tagset[selmon->seltags] & 1 << i)) {
+                    selmon->previewshow = i + 1;
+                    showtagpreview(i);
+                } else if (selmon->tagset[selmon->seltags] & 1 << i) {
                     selmon->previewshow = 0;
                     showtagpreview(0);
                 }
+            } else if (selmon->previewshow != 0) {
+                selmon->previewshow = 0;
+                showtagpreview(0);
+            }
+        } else {
+            /* back on the bar, the region has to be looked up again */
+            selmon->hoverx0 = selmon->hoverx1 = 0;
+            if (selmon->previewshow != 0) {
+                selmon->previewshow = 0;
+                showtagpreview(0);
             }
-        } else if (selmon->previewshow != 0) {
-            selmon->previewshow = 0;
-            showtagpreview(0);
         }
     }
 
@@ -2249,65 +2959,26 @@ motionnotify(XEvent *e)
     mon = m;
 }
 
+/* Starts moving the selected client, run() hands the pointer events to
+ * dragmotion and dragend until the button is released. */
 void
 movemouse(const Arg *arg)
 {
-    int x, y, ocx, ocy, nx, ny;
+    int x, y;
     Client *c;
-    Monitor *m;
-    XEvent ev;
-    Time lasttime = 0;
 
-    if (!(c = selmon->sel))
+    if (drag.c || !(c = selmon->sel))
         return;
     if (c->isfullscreen) /* no support moving fullscreen windows by mouse */
         return;
     restack(selmon);
-    ocx = c->x;
-    ocy = c->y;
     if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
         None, cursor[CurMove]->cursor, CurrentTime) != GrabSuccess)
         return;
     if (!getrootptr(&x, &y))
         return;
-    do {
-        XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
-        switch(ev.type) {
-        case ConfigureRequest:
-        case Expose:
-        case MapRequest:
-            handler[ev.type](&ev);
-            break;
-        case MotionNotify:
-            if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-                continue;
-            lasttime = ev.xmotion.time;
-
-            nx = ocx + (ev.xmotion.x - x);
-            ny = ocy + (ev.xmotion.y - y);
-            if (abs(selmon->wx - nx) < snap)
-                nx = selmon->wx;
-            else if (abs((selmon->wx + selmon->ww) - (nx + WIDTH(c))) < snap)
-                nx = selmon->wx + selmon->ww - WIDTH(c);
-            if (abs(selmon->wy - ny) < snap)
-                ny = selmon->wy;
-            else if (abs((selmon->wy + selmon->wh) - (ny + HEIGHT(c))) < snap)
-                ny = selmon->wy + selmon->wh - HEIGHT(c);
-            if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
-            && (abs(nx - c->x) > snap || abs(ny - c->y) > snap))
-                togglefloating(NULL);
-            if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
-                resize(c, nx, ny, c->w, c->h, 1);
-            break;
-        }
-    } while (ev.type != ButtonRelease);
-    XUngrabPointer(dpy, CurrentTime);
-    if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
-        sendmon(c, m);
-        prevmon = selmon;
-        selmon = m;
-        focus(NULL);
-    }
+    drag = (Drag) { .c = c, .x = x, .y = y, .ocx = c->x, .ocy = c->y,
+        .mode = c->dragmode ? c->dragmode : dragmode };
 }
 
 static void
@@ -2321,6 +2992,25 @@ movecenter(const Arg *arg)
     arrange(selmon);
 }
 
+/* the earliest time run() has something to do at, 0 for none */
+unsigned long long
+nextdeadline(void)
+{
+    unsigned long long t = drag.pending ? drag.due : 0;
+    Monitor *m;
+    Client *c;
+
+    if (drag.settle && (!t || drag.settle < t))
+        t = drag.settle;
+    if (chorddeadline && (!t || chorddeadline < t))
+        t = chorddeadline;
+    for (m = mons; syncwaits && m; m = m->next)
+        for (c = m->clients; c; c = c->next)
+            if (c->syncwait && (!t || c->syncdue < t))
+                t = c->syncdue;
+    return t;
+}
+
 unsigned int
 nexttag(int prev, int empty)
 {
@@ -2354,6 +3044,26 @@ nexttiled(Client *c)
     return c;
 }
 
+/* keeps the preview client-side as RGB565, 0 if the visual is not 0x00RRGGBB
+ * or the server's pixels are not in native byte order */
+int
+packpreview(Monitor *m, int i)
+{
+    int w = m->mw / scalepreview, h = m->mh / scalepreview;
+    Visual *v = DefaultVisual(dpy, screen);
+    XImage *img;
+
+    if (v->red_mask != 0xff0000 || v->green_mask != 0xff00 || v->blue_mask != 0xff
+    || !(img = ROUNDTRIP(XGetImage(dpy, m->tagmap[i], 0, 0, w, h, AllPlanes, ZPixmap))))
+        return 0;
+    if (img->bits_per_pixel == 32 && img->byte_order == HOSTBYTEORDER) {
+        m->tagcold[i] = ecalloc((size_t)w * h, sizeof(unsigned short));
+        rgb565_pack(m->tagcold[i], (unsigned char *)img->data, img->bytes_per_line, w, h);
+    }
+    XDestroyImage(img);
+    return m->tagcold[i] != NULL;
+}
+
 void
 pop(Client *c)
 {
@@ -2363,6 +3073,22 @@ pop(Client *c)
     arrange(c->mon);
 }
 
+void
+profbegin(ProfMark *pm)
+{
+    pm->req = XNextRequest(dpy);
+    pm->rt = roundtrips;
+    pm->t = prof_now();
+}
+
+/* requests are counted by sequence number, round trips by the wrappers in prof.h */
+void
+profend(Hist *h, const ProfMark *pm)
+{
+    hist_add(h, prof_now() - pm->t);
+    hist_addx(h, XNextRequest(dpy) - pm->req, roundtrips - pm->rt);
+}
+
 Client *
 prevtiled(Client *c) {
     Client *p, *r;
@@ -2659,85 +3385,45 @@ resizeclient(Client *c, int x, int y, int w, int h)
             wc.border_width = 0;
     }
 
-    XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
-    configure(c);
-    XSync(dpy, False);
+    /* the newest geometry goes out once the client has caught up */
+    if (c->syncwait) {
+        c->syncwc = wc;
+        c->syncpending = 1;
+        return;
+    }
+    configuresync(c, &wc, 1);
+    /* drag updates go out with the next flush, see dragupdate */
+    if (c != drag.c)
+        XSync(dpy, False);
 }
 
+/* Starts resizing the selected client from the corner nearest the
+ * pointer, see movemouse. */
 void
 resizemouse(const Arg *arg)
 {
-    int ocx, ocy, nw, nh;
-    int ocx2, ocy2, nx, ny;
+    int x, y;
     Client *c;
-    Monitor *m;
-    XEvent ev;
     int horizcorner, vertcorner;
-    int di;
-    unsigned int dui;
-    Window dummy;
-    Time lasttime = 0;
 
-    if (!(c = selmon->sel))
+    if (drag.c || !(c = selmon->sel))
         return;
     if (c->isfullscreen) /* no support resizing fullscreen windows by mouse */
         return;
     restack(selmon);
-    ocx = c->x;
-    ocy = c->y;
-    ocx2 = c->x + c->w;
-    ocy2 = c->y + c->h;
     if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
         None, cursor[CurResize]->cursor, CurrentTime) != GrabSuccess)
         return;
-    if (!XQueryPointer (dpy, c->win, &dummy, &dummy, &di, &di, &nx, &ny, &dui))
+    if (!getrootptr(&x, &y))
         return;
-    horizcorner = nx < c->w / 2;
-    vertcorner  = ny < c->h / 2;
-    XWarpPointer (dpy, None, c->win, 0, 0, 0, 0,
-            horizcorner ? (-c->bw) : (c->w + c->bw -1),
+    horizcorner = x - c->x - c->bw < c->w / 2;
+    vertcorner  = y - c->y - c->bw < c->h / 2;
+    warppointer(c, horizcorner ? (-c->bw) : (c->w + c->bw -1),
             vertcorner  ? (-c->bw) : (c->h + c->bw -1));
-    do {
-        XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
-        switch(ev.type) {
-        case ConfigureRequest:
-        case Expose:
-        case MapRequest:
-            handler[ev.type](&ev);
-            break;
-        case MotionNotify:
-            if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-                continue;
-            lasttime = ev.xmotion.time;
-
-            nx = horizcorner ? ev.xmotion.x : c->x;
-            ny = vertcorner ? ev.xmotion.y : c->y;
-            nw = MAX(horizcorner ? (ocx2 - nx) : (ev.xmotion.x - ocx - 2 * c->bw + 1), 1);
-            nh = MAX(vertcorner ? (ocy2 - ny) : (ev.xmotion.y - ocy - 2 * c->bw + 1), 1);
-
-            if (c->mon->wx + nw >= selmon->wx && c->mon->wx + nw <= selmon->wx + selmon->ww
-            && c->mon->wy + nh >= selmon->wy && c->mon->wy + nh <= selmon->wy + selmon->wh)
-            {
-                if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
-                && (abs(nw - c->w) > snap || abs(nh - c->h) > snap))
-                    togglefloating(NULL);
-            }
-            if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
-                resize(c, nx, ny, nw, nh, 1);
-            break;
-        }
-    } while (ev.type != ButtonRelease);
-    XWarpPointer(dpy, None, c->win, 0, 0, 0, 0,
-              horizcorner ? (-c->bw) : (c->w + c->bw - 1),
-              vertcorner ? (-c->bw) : (c->h + c->bw - 1));
-    XUngrabPointer(dpy, CurrentTime);
-    while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
-    if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
-        sendmon(c, m);
-        prevmon = selmon;
-        selmon = m;
-        focus(NULL);
-    }
+    drag = (Drag) { .c = c, .resize = 1, .ocx = c->x, .ocy = c->y,
+        .ocx2 = c->x + c->w, .ocy2 = c->y + c->h,
+        .horizcorner = horizcorner, .vertcorner = vertcorner,
+        .mode = c->dragmode ? c->dragmode : dragmode };
 }
 
 void
@@ -2753,6 +3439,37 @@ resizerequest(XEvent *e)
     }
 }
 
+/* drops a pending keychord and grabs the first keys again */
+void
+resetchord(void)
+{
+    if (keystate == &keytrie)
+        return;
+    grabkeystep(keystate, &keytrie);
+    keystate = &keytrie;
+    chorddeadline = 0;
+}
+
+/* fires what nextdeadline waited for */
+void
+runtimers(void)
+{
+    unsigned long long t = prof_now();
+    Monitor *m;
+    Client *c;
+
+    if (drag.pending && drag.due <= t)
+        dragupdate();
+    if (drag.settle && drag.settle <= t)
+        dragsettle();
+    if (chorddeadline && chorddeadline <= t)
+        resetchord();
+    for (m = mons; syncwaits && m; m = m->next)
+        for (c = m->clients; c; c = c->next)
+            if (c->syncwait && c->syncdue <= t)
+                syncdone(c, 0);
+}
+
 void
 restack(Monitor *m)
 {
@@ -2764,6 +3481,7 @@ restack(Monitor *m)
     drawtab(m);
     if (!m->sel)
         return;
+    TRACEBEGIN("restack");
     if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
         XRaiseWindow(dpy, m->sel->win);
     if (m->lt[m->sellt]->arrange) {
@@ -2776,21 +3494,74 @@ restack(Monitor *m)
             }
     }
     XSync(dpy, False);
-    while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+    while (XCheckMaskEvent(dpy, EnterWindowMask, &ev))
+        trackpointer(&ev);
     if (m == selmon && (m->tagset[m->seltags] & m->sel->tags) && selmon->lt[selmon->sellt] != &layouts[2])
         warp(m->sel);
+    TRACEEND("restack");
+}
+
+/* RandR reports every output and crtc of a change on its own, see applygeom */
+void
+rrnotify(XEvent *e)
+{
+    if (e->type == rrevent + RRScreenChangeNotify)
+        XRRUpdateConfiguration(e);
+    geomdirty = 1;
 }
 
 void
 run(void)
 {
     XEvent ev;
+    ProfMark pm;
+    unsigned long long t;
     /* main event loop */
     XSync(dpy, False);
-    while (running && !XNextEvent(dpy, &ev))
-    {
-        if (handler[ev.type])
+    while (running) {
+        if (!XPending(dpy)) {
+            /* monitor changes come in bursts, applied once one is over */
+            if (geomdirty) {
+                applygeom();
+                continue;
+            }
+            /* tag previews are scaled only while no event is waiting */
+            if (capturetag())
+                continue;
+            if ((t = nextdeadline()) && !waitevent(t)) {
+                runtimers();
+                continue;
+            }
+        }
+        if (XNextEvent(dpy, &ev))
+            break;
+        trackpointer(&ev);
+        if (profdump) {
+            profdump = 0;
+            dumpprofile(&((Arg) { .i = 0 }));
+        }
+        if (usedamage && ev.type == damageevent + XDamageNotify) {
+            damagenotify(&ev);
+            continue;
+        }
+        if (usesync && ev.type == syncevent + XSyncAlarmNotify) {
+            syncnotify(&ev);
+            continue;
+        }
+        if (randr15 && (ev.type == rrevent + RRScreenChangeNotify || ev.type == rrevent + RRNotify)) {
+            rrnotify(&ev);
+            continue;
+        }
+        if (ev.type >= LASTEvent || !handler[ev.type])
+            continue;
+        TRACEBEGIN(evhist[ev.type].name);
+        if (profile) {
+            profbegin(&pm);
+            handler[ev.type](&ev); /* call handler */
+            profend(&evhist[ev.type], &pm);
+        } else
             handler[ev.type](&ev); /* call handler */
+        TRACEEND(evhist[ev.type].name);
     }
 }
 
@@ -3034,8 +3805,11 @@ sendmon(Client *c, Monitor *m)
     unfocus(c, 1);
     detach(c);
     detachstack(c);
+    c->mon->tagvalid &= ~c->tags;
     c->mon = m;
+    c->homename = None;
     c->tags = (m->tagset[m->seltags] ? m->tagset[m->seltags] : 1);
+    m->tagvalid &= ~c->tags;
     if (attachbelow)
         attachBelow(c);
     else
@@ -3208,6 +3982,37 @@ setlayout(const Arg *arg)
     }
 }
 
+/* Frames x, y, w, h with b wide edges above all windows, or hides the
+ * frame if w is 0. The edges are separate windows so nothing below them
+ * has to be redrawn or grabbed while they move. */
+void
+setoutline(int x, int y, int w, int h, int b)
+{
+    XSetWindowAttributes wa = {
+        .override_redirect = True,
+        .background_pixel = scheme[SchemeSel][ColFloat].pixel
+    };
+    int i;
+
+    if (!w) {
+        for (i = 0; i < LENGTH(outline); i++)
+            if (outline[i])
+                XUnmapWindow(dpy, outline[i]);
+        return;
+    }
+    for (i = 0; i < LENGTH(outline); i++)
+        if (!outline[i])
+            outline[i] = XCreateWindow(dpy, root, 0, 0, 1, 1, 0, DefaultDepth(dpy, screen),
+                CopyFromParent, DefaultVisual(dpy, screen), CWOverrideRedirect|CWBackPixel, &wa);
+    h = MAX(h, 2 * b + 1);
+    XMoveResizeWindow(dpy, outline[0], x, y, w, b);
+    XMoveResizeWindow(dpy, outline[1], x, y + h - b, w, b);
+    XMoveResizeWindow(dpy, outline[2], x, y + b, b, h - 2 * b);
+    XMoveResizeWindow(dpy, outline[3], x + w - b, y + b, b, h - 2 * b);
+    for (i = 0; i < LENGTH(outline); i++)
+        XMapRaised(dpy, outline[i]);
+}
+
 void setcfact(const Arg *arg) {
     float f;
     Client *c;
@@ -3254,7 +4059,7 @@ setscratch(const Arg *arg)
 void
 setup(void)
 {
-    int i;
+    int i, major, minor;
     XSetWindowAttributes wa;
     Atom utf8string;
 
@@ -3263,6 +4068,7 @@ setup(void)
 
     signal(SIGHUP, sighup);
     signal(SIGTERM, sigterm);
+    signal(SIGUSR1, sigusr1);
 
  	putenv("_JAVA_AWT_WM_NONREPARENTING=1");
 
@@ -3277,6 +4083,22 @@ setup(void)
     lrpad = drw->fonts->h + horizpadbar;
     bh = user_bh ? user_bh + vertpadbar: drw->fonts->h + 2 + vertpadbar;
     th = bh;
+    randr = XRRQueryExtension(dpy, &rrevent, &i) && XRRQueryVersion(dpy, &major, &minor)
+        && (major > 1 || minor >= 2);
+    randr15 = randr && (major > 1 || minor >= 5);
+    if (randr15)
+        XRRSelectInput(dpy, root, RRScreenChangeNotifyMask|RRCrtcChangeNotifyMask|RROutputChangeNotifyMask);
+    major = 2;
+    minor = 0;
+    if (rawmotion && XQueryExtension(dpy, "XInputExtension", &xiopcode, &i, &i)
+    && XIQueryVersion(dpy, &major, &minor) == Success) {
+        unsigned char bits[XIMaskLen(XI_RawMotion)] = { 0 };
+        XIEventMask mask = { XIAllMasterDevices, sizeof bits, bits };
+
+        XISetMask(bits, XI_RawMotion);
+        XISelectEvents(dpy, root, &mask, 1);
+    } else
+        xiopcode = 0;
     updategeom();
 
     /* init atoms */
@@ -3308,8 +4130,11 @@ setup(void)
     netatom[NetDesktopViewport] = XInternAtom(dpy, "_NET_DESKTOP_VIEWPORT", False);
     netatom[NetNumberOfDesktops] = XInternAtom(dpy, "_NET_NUMBER_OF_DESKTOPS", False);
     netatom[NetCurrentDesktop] = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
+    netatom[NetWMSyncRequest] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST", False);
+    netatom[NetWMSyncRequestCounter] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST_COUNTER", False);
     netatom[NetDesktopNames] = XInternAtom(dpy, "_NET_DESKTOP_NAMES", False);
     motifatom = XInternAtom(dpy, "_MOTIF_WM_HINTS", False);
+    fsignalatom = XInternAtom(dpy, "_DWM_FSIGNAL", False);
     xatom[Manager] = XInternAtom(dpy, "MANAGER", False);
     xatom[Xembed] = XInternAtom(dpy, "_XEMBED", False);
     xatom[XembedInfo] = XInternAtom(dpy, "_XEMBED_INFO", False);
@@ -3322,6 +4147,20 @@ setup(void)
     scheme[LENGTH(colors)] = drw_scm_create(drw, colors[0], 9);
     for (i = 0; i < LENGTH(colors); i++)
         scheme[i] = drw_scm_create(drw, colors[i], 9);
+    /* tag previews copy the screen with the windows on it */
+    snapgc = XCreateGC(dpy, root, GCSubwindowMode, &((XGCValues) { .subwindow_mode = IncludeInferiors }));
+    useshm = *DisplayString(dpy) == ':' && XShmQueryExtension(dpy);
+    /* live previews need the windows' own pixmaps and a server-side scale */
+    if (previewlive && XCompositeQueryExtension(dpy, &i, &i)
+    && XCompositeQueryVersion(dpy, &major, &minor) && (major > 0 || minor >= 2)
+    && XRenderQueryExtension(dpy, &i, &i)) {
+        XCompositeRedirectSubwindows(dpy, root, CompositeRedirectAutomatic);
+        livepreview = 1;
+    }
+    /* without XDamage every switch captures, as nothing says a preview is current */
+    if (!livepreview && XDamageQueryExtension(dpy, &damageevent, &i))
+        usedamage = 1;
+    usesync = XSyncQueryExtension(dpy, &syncevent, &i) && XSyncInitialize(dpy, &major, &minor);
     /* init system tray */
     updatesystray();
     /* init bars */
@@ -3353,6 +4192,8 @@ setup(void)
     XChangeWindowAttributes(dpy, root, CWEventMask|CWCursor, &wa);
     XSelectInput(dpy, root, wa.event_mask);
 
+    updatekeymap();
+    buildkeytrie();
     grabkeys();
     focus(NULL);
 }
@@ -3376,6 +4217,48 @@ seturgent(Client *c, int urg)
     XFree(wmh);
 }
 
+/* (re)creates img as a w×h shared memory image, turns MIT-SHM off if that fails */
+int
+shmimage(XImage **img, XShmSegmentInfo *si, int w, int h)
+{
+    if (*img && (*img)->width == w && (*img)->height == h)
+        return 1;
+    freeshmimage(img, si);
+    if (!(*img = XShmCreateImage(dpy, DefaultVisual(dpy, screen), DefaultDepth(dpy, screen),
+        ZPixmap, NULL, si, w, h)))
+        return useshm = 0;
+    if ((*img)->bits_per_pixel != 32
+    || (si->shmid = shmget(IPC_PRIVATE, (*img)->bytes_per_line * h, IPC_CREAT | 0600)) < 0) {
+        XDestroyImage(*img);
+        *img = NULL;
+        return useshm = 0;
+    }
+    if ((si->shmaddr = (*img)->data = shmat(si->shmid, NULL, 0)) == (char *)-1) {
+        shmctl(si->shmid, IPC_RMID, NULL);
+        (*img)->data = NULL;
+        XDestroyImage(*img);
+        *img = NULL;
+        return useshm = 0;
+    }
+    si->readOnly = False;
+    /* a server that cannot reach the segment refuses the attach */
+    XSync(dpy, False);
+    shmfailed = 0;
+    XSetErrorHandler(xerrorshm);
+    XShmAttach(dpy, si);
+    XSync(dpy, False);
+    XSetErrorHandler(xerror);
+    shmctl(si->shmid, IPC_RMID, NULL); /* freed once both sides detach */
+    if (shmfailed) {
+        shmdt(si->shmaddr);
+        (*img)->data = NULL;
+        XDestroyImage(*img);
+        *img = NULL;
+        return useshm = 0;
+    }
+    return 1;
+}
+
 void
 showhide(Client *c)
 {
@@ -3384,6 +4267,10 @@ showhide(Client *c)
     if (ISVISIBLE(c)) {
         /* show clients top down */
         XMoveWindow(dpy, c->win, c->x, c->y);
+        if (c->hidden) {
+            c->hidden = 0;
+            c->exposed = prof_now();
+        }
         if (c->needresize) {
             c->needresize = 0;
             XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
@@ -3400,6 +4287,7 @@ showhide(Client *c)
         /* hide clients bottom up */
         showhide(c->snext);
         XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+        c->hidden = 1;
     }
 }
 
@@ -3411,7 +4299,14 @@ showtagpreview(int tag)
         return;
     }
 
+    if (livepreview)
+        composepreview(selmon, tag);
+    else if (selmon->tagsnap[tag])
+        while (capturetag() && selmon->tagsnap[tag]);
+    if (!selmon->tagmap[tag] && selmon->tagcold[tag])
+        unpackpreview(selmon, tag);
     if (selmon->tagmap[tag]) {
+        selmon->tagused[tag] = ++previewclock;
         XSetWindowBackgroundPixmap(dpy, selmon->tagwin, selmon->tagmap[tag]);
         XCopyArea(dpy, selmon->tagmap[tag], selmon->tagwin, drw->gc, 0, 0, selmon->mw / scalepreview, selmon->mh / scalepreview, 0, 0);
         XSync(dpy, False);
@@ -3442,6 +4337,13 @@ sigterm(int unused)
     quit(&a);
 }
 
+/* the dump happens in run() once the next event arrives */
+void
+sigusr1(int unused)
+{
+    profdump = 1;
+}
+
 void
 spawn(const Arg *arg)
 {
@@ -3494,6 +4396,7 @@ swaptags(const Arg *arg)
     if (newtag == curtag || !curtag || (curtag & (curtag-1)))
         return;
 
+    selmon->tagvalid &= ~(curtag | newtag);
     for (Client *c = selmon->clients; c != NULL; c = c->next) {
         if ((c->tags & newtag) || (c->tags & curtag))
             c->tags ^= curtag ^ newtag;
@@ -3522,44 +4425,145 @@ spawnscratch(const Arg *arg)
      }
 }
 
+/* Only copies the screen into a pixmap on the server, which needs no
+ * reply. Reading it back and scaling it is left to capturetag. */
 void
 switchtag(void)
+{
+    XEvent ev;
+
+    if (livepreview)
+        return; /* composepreview draws them on hover */
+    PROFBEGIN();
+
+    /* damage still in the queue counts against the tags leaving the screen */
+    while (usedamage && XCheckTypedEvent(dpy, damageevent + XDamageNotify, &ev))
+        damagenotify(&ev);
+    snaptags(selmon, selmon->tagset[selmon->seltags] & ~selmon->tagvalid);
+    PROFEND(ProfSwitchtag);
+}
+
+/* the server memory taken by captures capturetag has not scaled yet */
+size_t
+snapbytes(void)
+{
+    Monitor *m;
+    int i;
+    size_t n = 0;
+
+    for (m = mons; m; m = m->next)
+        for (i = 0; i < LENGTH(tags); i++)
+            if (m->tagsnap[i])
+                n += (size_t)4 * m->ww * m->wh;
+    return n;
+}
+
+/* Replaces the captures of the given tags, which m must be showing, with
+ * what is on its screen now. */
+void
+snaptags(Monitor *m, unsigned int tagmask)
 {
     int i;
     unsigned int occ = 0;
     Client *c;
-    Imlib_Image image;
 
-    for (c = selmon->clients; c; c = c->next)
+    for (c = m->clients; c; c = c->next)
         occ |= c->tags;
     for (i = 0; i < LENGTH(tags); i++) {
-        if (selmon->tagset[selmon->seltags] & 1 << i) {
-            if (selmon->tagmap[i] != 0) {
-                XFreePixmap(dpy, selmon->tagmap[i]);
-                selmon->tagmap[i] = 0;
+        if (tagmask & 1 << i) {
+            if (m->tagmap[i] != 0) {
+                XFreePixmap(dpy, m->tagmap[i]);
+                m->tagmap[i] = 0;
             }
+            if (m->tagsnap[i] != 0) {
+                XFreePixmap(dpy, m->tagsnap[i]);
+                m->tagsnap[i] = 0;
+            }
+            free(m->tagcold[i]);
+            m->tagcold[i] = NULL;
             if (occ & 1 << i) {
-                image = imlib_create_image(sw, sh);
-                imlib_context_set_image(image);
-                imlib_context_set_display(dpy);
-                imlib_context_set_visual(DefaultVisual(dpy, screen));
-                imlib_context_set_drawable(RootWindow(dpy, screen));
-                //uncomment the following line and comment the other imlin_copy.. line if you don't want the bar showing on the preview
-                imlib_copy_drawable_to_image(0, selmon->wx, selmon->wy, selmon->ww ,selmon->wh, 0, 0, 1);
-                /* imlib_copy_drawable_to_image(0, selmon->mx, selmon->my, selmon->mw ,selmon->mh, 0, 0, 1); */
-                selmon->tagmap[i] = XCreatePixmap(dpy, selmon->tagwin, selmon->mw / scalepreview, selmon->mh / scalepreview, DefaultDepth(dpy, screen));
-                imlib_context_set_drawable(selmon->tagmap[i]);
-                imlib_render_image_part_on_drawable_at_size(0, 0, selmon->mw, selmon->mh, 0, 0, selmon->mw / scalepreview, selmon->mh / scalepreview);
-                imlib_free_image();
+                /* the ones already pending are scaled first if there is
+                 * no room for another in previewbudget */
+                while (snapbytes() + (size_t)4 * m->ww * m->wh > previewbudget && capturetag());
+                m->tagsnap[i] = XCreatePixmap(dpy, root, m->ww, m->wh, DefaultDepth(dpy, screen));
+                //use mx, my, mw and mh instead if you want the bar showing on the preview
+                XCopyArea(dpy, root, m->tagsnap[i], snapgc, m->wx, m->wy, m->ww, m->wh, 0, 0);
+                if (usedamage)
+                    m->tagvalid |= 1 << i;
             }
         }
     }
+    /* what they draw from now on is news to the new captures */
+    for (c = m->clients; usedamage && c; c = c->next)
+        if (ISVISIBLE(c) && c->tags & tagmask)
+            XDamageSubtract(dpy, c->damage, None, None);
+    trimpreviews();
+}
+
+/* Scales one pending capture into its tag preview, returns 0 if none was
+ * pending. With MIT-SHM it is read back SNAPROWS preview rows at a time
+ * and box filtered, else Imlib2 reads and scales all of it. */
+int
+capturetag(void)
+{
+    int i, y, rows, f = scalepreview;
+    Monitor *m;
+    Imlib_Image image;
+
+    for (m = mons; m; m = m->next) {
+        for (i = 0; i < LENGTH(tags) && !m->tagsnap[i]; i++);
+        if (i < LENGTH(tags))
+            break;
+    }
+    if (!m)
+        return 0;
+
+    PROFBEGIN();
+    m->tagmap[i] = XCreatePixmap(dpy, m->tagwin, m->mw / f, m->mh / f, DefaultDepth(dpy, screen));
+    if (useshm && f <= BOX_MAXF
+    && shmimage(&snapimg, &snapshm, m->ww / f * f, SNAPROWS * f)
+    && shmimage(&thumbimg, &thumbshm, m->mw / f, m->mh / f)) {
+        /* the reply to XShmGetImage also means the last XShmPutImage is
+         * done with thumbimg */
+        for (y = 0; y < m->wh / f; y += rows) {
+            rows = MIN(SNAPROWS, m->wh / f - y);
+            snapimg->height = rows * f;
+            ROUNDTRIP(XShmGetImage(dpy, m->tagsnap[i], snapimg, 0, y * f, AllPlanes));
+            box_downscale((unsigned char *)thumbimg->data + y * thumbimg->bytes_per_line,
+                thumbimg->bytes_per_line, (unsigned char *)snapimg->data,
+                snapimg->bytes_per_line, snapimg->width, rows * f, f);
+        }
+        snapimg->height = SNAPROWS * f;
+        memset(thumbimg->data + y * thumbimg->bytes_per_line, 0,
+            (thumbimg->height - y) * thumbimg->bytes_per_line);
+        XShmPutImage(dpy, m->tagmap[i], drw->gc, thumbimg, 0, 0, 0, 0,
+            thumbimg->width, thumbimg->height, False);
+    } else {
+        if (!useshm)
+            freeshmimage(&snapimg, &snapshm);
+        image = imlib_create_image(m->ww, m->wh);
+        imlib_context_set_image(image);
+        imlib_context_set_display(dpy);
+        imlib_context_set_visual(DefaultVisual(dpy, screen));
+        imlib_context_set_drawable(m->tagsnap[i]);
+        ROUNDTRIP(imlib_copy_drawable_to_image(0, 0, 0, m->ww, m->wh, 0, 0, 1));
+        imlib_context_set_drawable(m->tagmap[i]);
+        imlib_render_image_part_on_drawable_at_size(0, 0, m->ww, m->wh, 0, 0, m->ww / f, m->wh / f);
+        imlib_free_image();
+    }
+    XFreePixmap(dpy, m->tagsnap[i]);
+    m->tagsnap[i] = 0;
+    m->tagused[i] = ++previewclock;
+    trimpreviews();
+    PROFEND(ProfCapturetag);
+    return 1;
 }
 
 void
 tag(const Arg *arg)
 {
     if (selmon->sel && arg->ui & TAGMASK) {
+        selmon->tagvalid &= ~(selmon->sel->tags | arg->ui);
         selmon->sel->tags = arg->ui & TAGMASK;
         if (selmon->sel->switchtag)
             selmon->sel->switchtag = 0;
@@ -3573,6 +4577,7 @@ tagall(const Arg *arg) {
     if (!selmon->clients)
         return;
 
+    selmon->tagvalid &= ~(selmon->tagset[selmon->seltags] | 1 << arg->ui);
     for (Client *c = selmon->clients; c; c = c->next) {
         for (int j = 0; j < LENGTH(tags); j++) {
             if (c->tags & 1 << j && selmon->tagset[selmon->seltags] & 1 << j) {
@@ -3590,6 +4595,7 @@ tagallfloat(const Arg *arg) {
     if (!selmon->clients)
         return;
 
+    selmon->tagvalid &= ~(selmon->tagset[selmon->seltags] | 1 << arg->ui);
     for(Client *c = selmon->clients; c; c = c->next) {
         if (c->isfloating) {
             for(int j = 0; j < LENGTH(tags); j++) {
@@ -3608,6 +4614,7 @@ void
 tagwith(const Arg *arg)
 {
     if (selmon->sel && arg->ui & TAGMASK) {
+        selmon->tagvalid &= ~(selmon->sel->tags | arg->ui);
         selmon->sel->tags = arg->ui & TAGMASK;
         if (selmon->sel->switchtag)
             selmon->sel->switchtag = 0;
@@ -3851,6 +4858,7 @@ toggletag(const Arg *arg)
         return;
     newtags = selmon->sel->tags ^ (arg->ui & TAGMASK);
     if (newtags) {
+        selmon->tagvalid &= ~(selmon->sel->tags | newtags);
         selmon->sel->tags = newtags;
         focus(NULL);
         arrange(selmon);
@@ -3878,6 +4886,52 @@ toggleview(const Arg *arg)
     updatecurrentdesktop();
 }
 
+/* Evicts the least recently used tag previews of all monitors until they
+ * and the captures still to be scaled fit in previewbudget. Pixmaps in the
+ * server go first, packed to RGB565 if previewcompress is set, then the
+ * packed copies. A preview that is shown is never evicted. */
+void
+trimpreviews(void)
+{
+    Monitor *m, *hm, *cm;
+    int i, hi = 0, ci = 0;
+    size_t px, used;
+
+    for (;;) {
+        used = snapbytes();
+        hm = cm = NULL;
+        for (m = mons; m; m = m->next) {
+            px = (size_t)(m->mw / scalepreview) * (m->mh / scalepreview);
+            for (i = 0; i < LENGTH(tags); i++) {
+                used += (m->tagmap[i] ? 4 * px : 0) + (m->tagcold[i] ? 2 * px : 0);
+                if (m->previewshow == i + 1)
+                    continue;
+                if (m->tagmap[i] && (!hm || m->tagused[i] < hm->tagused[hi])) {
+                    hm = m;
+                    hi = i;
+                }
+                if (m->tagcold[i] && (!cm || m->tagused[i] < cm->tagused[ci])) {
+                    cm = m;
+                    ci = i;
+                }
+            }
+        }
+        if (used <= previewbudget)
+            return;
+        if (hm) {
+            if (!previewcompress || !packpreview(hm, hi))
+                hm->tagvalid &= ~(1 << hi);
+            XFreePixmap(dpy, hm->tagmap[hi]);
+            hm->tagmap[hi] = 0;
+        } else if (cm) {
+            free(cm->tagcold[ci]);
+            cm->tagcold[ci] = NULL;
+            cm->tagvalid &= ~(1 << ci);
+        } else
+            return;
+    }
+}
+
 void
 togglevacant(const Arg *arg)
 {
@@ -3917,6 +4971,69 @@ togglepreview(const Arg *arg)
     showpreview = !showpreview;
 }
 
+void
+toggleprofile(const Arg *arg)
+{
+    profile = !profile;
+}
+
+void
+toggletrace(const Arg *arg)
+{
+    tracing = !tracing;
+}
+
+/* Follows the pointer through the events that carry its position. Crossing
+ * events also come when windows change under a still pointer, so the window
+ * under it stays right; only motion inside a client goes unseen, which raw
+ * motion reports when rawmotion is set. */
+void
+trackpointer(XEvent *e)
+{
+    XCrossingEvent *ev = &e->xcrossing;
+    Bool same;
+
+    switch (e->type) {
+    case KeyPress:
+    case KeyRelease:
+        same = e->xkey.same_screen;
+        break;
+    case ButtonPress:
+    case ButtonRelease:
+        same = e->xbutton.same_screen;
+        break;
+    case MotionNotify:
+        same = e->xmotion.same_screen;
+        break;
+    case EnterNotify:
+    case LeaveNotify:
+        same = ev->same_screen;
+        break;
+    case GenericEvent:
+        if (e->xcookie.extension == xiopcode && e->xcookie.evtype == XI_RawMotion)
+            ptr.moved = 1;
+        return;
+    default:
+        return;
+    }
+    if (!same) {
+        ptr.lost = 1;
+        return;
+    }
+    /* window, subwindow and the root coordinates are common to all of them */
+    ptr.x = ev->x_root;
+    ptr.y = ev->y_root;
+    ptr.moved = 0;
+    /* a grab moves the pointer into the grab window only logically */
+    if ((e->type == EnterNotify || e->type == LeaveNotify) && ev->mode == NotifyGrab)
+        return;
+    ptr.win = ev->window == root ? ev->subwindow : ev->window;
+    ptr.lost = 0;
+    /* without raw motion the position is stale as soon as it is in a client */
+    if (!xiopcode && ptr.win && wintoclient(ptr.win))
+        ptr.moved = 1;
+}
+
 void
 unfocus(Client *c, int setfocus)
 {
@@ -3943,6 +5060,24 @@ unfocus(Client *c, int setfocus)
     updatecurrentdesktop();
 }
 
+void
+unpackpreview(Monitor *m, int i)
+{
+    int w = m->mw / scalepreview, h = m->mh / scalepreview;
+    XImage *img;
+
+    img = XCreateImage(dpy, DefaultVisual(dpy, screen), DefaultDepth(dpy, screen), ZPixmap, 0,
+        ecalloc((size_t)w * h, 4), w, h, 32, 0);
+    img->byte_order = HOSTBYTEORDER; /* rgb565_unpack writes native pixels */
+    rgb565_unpack((unsigned char *)img->data, img->bytes_per_line, m->tagcold[i], w, h);
+    m->tagmap[i] = XCreatePixmap(dpy, m->tagwin, w, h, DefaultDepth(dpy, screen));
+    XPutImage(dpy, m->tagmap[i], drw->gc, img, 0, 0, 0, 0, w, h);
+    XDestroyImage(img);
+    free(m->tagcold[i]);
+    m->tagcold[i] = NULL;
+    trimpreviews();
+}
+
 void
 unmanage(Client *c, int destroyed)
 {
@@ -3950,7 +5085,15 @@ unmanage(Client *c, int destroyed)
     unsigned int switchtag = c->switchtag;
     XWindowChanges wc;
 
+    if (c == drag.c)
+        dragabort();
+    m->tagvalid &= ~c->tags;
+    syncdrop(c);
+    if (c->syncalarm)
+        XSyncDestroyAlarm(dpy, c->syncalarm);
     if (c->swallowing) {
+        if (!destroyed && c->damage)
+            XDamageDestroy(dpy, c->damage);
         unswallow(c);
         return;
     }
@@ -3966,12 +5109,17 @@ unmanage(Client *c, int destroyed)
 
     detach(c);
     detachstack(c);
+    /* the crossing events for what is under the pointer now are still to come */
+    if (ptr.win == c->win)
+        ptr.lost = 1;
     if (!destroyed) {
         wc.border_width = c->oldbw;
         XGrabServer(dpy); /* avoid race conditions */
         XSetErrorHandler(xerrordummy);
         XConfigureWindow(dpy, c->win, CWBorderWidth, &wc); /* restore border */
         XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
+        if (c->damage)
+            XDamageDestroy(dpy, c->damage);
         setclientstate(c, WithdrawnState);
         XSync(dpy, False);
         XSetErrorHandler(xerror);
@@ -4102,8 +5250,15 @@ updatecurrentdesktop(void)
 int
 updategeom(void)
 {
-    int dirty = 0;
+    int dirty = 0, nrr = 0;
+    Monitor *m;
+    XRRMonitorInfo *rr = randr15 ? XRRGetMonitors(dpy, root, True, &nrr) : NULL;
 
+    for (m = mons; m; m = m->next)
+        m->dirty = 0;
+    if (rr && nrr > 0)
+        dirty = updatemonitors(rr, nrr);
+    else
 #ifdef XINERAMA
     if (XineramaIsActive(dpy)) {
         int i, j, n, nn;
@@ -4133,19 +5288,20 @@ updategeom(void)
                 || unique[i].x_org != m->mx || unique[i].y_org != m->my
                 || unique[i].width != m->mw || unique[i].height != m->mh)
                 {
-                    dirty = 1;
+                    dirty = m->dirty = 1;
                     m->num = i;
                     m->mx = m->wx = unique[i].x_org;
                     m->my = m->wy = unique[i].y_org;
                     m->mw = m->ww = unique[i].width;
                     m->mh = m->wh = unique[i].height;
                     updatebarpos(m);
+                    freepreviews(m);
                 }
         } else { /* less monitors available nn < n */
             for (i = nn; i < n; i++) {
                 for (m = mons; m && m->next; m = m->next);
                 while ((c = m->clients)) {
-                    dirty = 1;
+                    dirty = mons->dirty = 1;
                     m->clients = c->next;
                     detachstack(c);
                     c->mon = mons;
@@ -4166,17 +5322,104 @@ updategeom(void)
     { /* default monitor setup */
         if (!mons)
             mons = createmon();
+        mons->mmw = DisplayWidthMM(dpy, screen);
+        mons->mmh = DisplayHeightMM(dpy, screen);
         if (mons->mw != sw || mons->mh != sh) {
-            dirty = 1;
+            dirty = mons->dirty = 1;
             mons->mw = mons->ww = sw;
             mons->mh = mons->wh = sh;
             updatebarpos(mons);
+            freepreviews(mons);
         }
     }
+    if (rr)
+        XRRFreeMonitors(rr);
     if (dirty) {
         selmon = mons;
         selmon = wintomon(root);
     }
+    updaterefresh();
+    return dirty;
+}
+
+/* Matches the RandR 1.5 monitors to ours by name. Only monitors that come,
+ * go or change geometry are touched and marked dirty. The clients of one
+ * that goes away wait on the first monitor and go back to it by name when
+ * it returns, so undocking and docking again leaves everything in place. */
+int
+updatemonitors(XRRMonitorInfo *info, int n)
+{
+    int i, dirty = 0;
+    Client *c, *next;
+    Monitor *m, *t, **pm, *gone = mons;
+
+    /* relink the monitors in RandR's order, the ones left over went away */
+    mons = NULL;
+    for (i = 0, pm = &mons; i < n; i++, pm = &m->next) {
+        for (t = NULL, m = gone; m && m->name != info[i].name; t = m, m = m->next);
+        if (m)
+            *(t ? &t->next : &gone) = m->next;
+        else {
+            m = createmon();
+            m->name = info[i].name;
+        }
+        m->next = NULL;
+        *pm = m;
+        m->num = i;
+        m->mmw = info[i].mwidth;
+        m->mmh = info[i].mheight;
+        if (info[i].x != m->mx || info[i].y != m->my
+        || info[i].width != m->mw || info[i].height != m->mh)
+        {
+            dirty = m->dirty = 1;
+            m->mx = m->wx = info[i].x;
+            m->my = m->wy = info[i].y;
+            m->mw = m->ww = info[i].width;
+            m->mh = m->wh = info[i].height;
+            updatebarpos(m);
+            freepreviews(m);
+        }
+    }
+    *pm = gone;
+    while ((m = gone)) {
+        gone = m->next;
+        while ((c = m->clients)) {
+            dirty = mons->dirty = 1;
+            m->clients = c->next;
+            detachstack(c);
+            if (!c->homename)
+                c->homename = m->name;
+            c->mon = mons;
+            if (attachbelow)
+                attachBelow(c);
+            else
+                attach(c);
+            attachstack(c);
+        }
+        if (m == selmon)
+            selmon = mons;
+        if (m == prevmon)
+            prevmon = NULL;
+        cleanupmon(m);
+    }
+    for (m = mons; m; m = m->next)
+        for (c = m->clients; c; c = next) {
+            next = c->next;
+            if (!c->homename)
+                continue;
+            for (t = mons; t && t->name != c->homename; t = t->next);
+            if (!t)
+                continue;
+            c->homename = None;
+            if (t == m)
+                continue;
+            detach(c);
+            detachstack(c);
+            c->mon = t;
+            attach(c);
+            attachstack(c);
+            dirty = m->dirty = t->dirty = 1;
+        }
     return dirty;
 }
 
@@ -4213,22 +5456,107 @@ updatemotifhints(Client *c)
     }
 }
 
+/* Resolves the keys that can follow each node of the trie to keycodes, so
+ * chord steps make no keymap lookups. Other keys still go to the focused
+ * client and leave a pending chord alone; Escape, which every node but the
+ * root grabs, cancels it, as does keychordtimeout if set. */
 void
-updatenumlockmask(void)
+updatekeygrabs(KeyNode *n)
 {
+    KeyNode *k;
+    KeyCode code;
     unsigned int i, j;
+
+    free(n->grabs);
+    n->grabs = ecalloc(n->nkids + 1, sizeof(KeyGrab));
+    n->ngrabs = 0;
+    for (i = 0; i < n->size; i++)
+        for (k = n->kids[i]; k; k = k->next) {
+            if ((code = keycodeof(k->keysym)))
+                n->grabs[n->ngrabs++] = (KeyGrab) { code, k->mod };
+            updatekeygrabs(k);
+        }
+    if (n != &keytrie && (code = keycodeof(XK_Escape)))
+        n->grabs[n->ngrabs++] = (KeyGrab) { code, AnyModifier };
+    qsort(n->grabs, n->ngrabs, sizeof(KeyGrab), keygrabcmp);
+    /* press and release chords on the same key share a grab */
+    for (i = j = 0; i < n->ngrabs; i++)
+        if (!j || keygrabcmp(&n->grabs[j - 1], &n->grabs[i]))
+            n->grabs[j++] = n->grabs[i];
+    n->ngrabs = j;
+}
+
+/* Caches the keyboard and modifier mappings, two round trips. keypress,
+ * the key grabs and CLEANMASK all read from here, so nothing but
+ * mappingnotify asks the server about the keyboard. */
+void
+updatekeymap(void)
+{
+    int i, j, min, max, per;
+    KeySym *map;
     XModifierKeymap *modmap;
+    KeyCode numlock;
+
+    memset(keysyms, 0, sizeof keysyms);
+    XDisplayKeycodes(dpy, &min, &max);
+    if ((map = XGetKeyboardMapping(dpy, min, max - min + 1, &per))) {
+        for (i = min; i <= max; i++)
+            for (j = 0; j < MIN(per, KEYLEVELS); j++)
+                keysyms[i][j] = map[(i - min) * per + j];
+        XFree(map);
+    }
 
     numlockmask = 0;
-    modmap = XGetModifierMapping(dpy);
+    if (!(numlock = keycodeof(XK_Num_Lock)) || !(modmap = XGetModifierMapping(dpy)))
+        return;
     for (i = 0; i < 8; i++)
         for (j = 0; j < modmap->max_keypermod; j++)
-            if (modmap->modifiermap[i * modmap->max_keypermod + j]
-                == XKeysymToKeycode(dpy, XK_Num_Lock))
+            if (modmap->modifiermap[i * modmap->max_keypermod + j] == numlock)
                 numlockmask = (1 << i);
     XFreeModifiermap(modmap);
 }
 
+/* Sets each monitor's frame time from the fastest crtc showing part of it,
+ * 60 Hz for monitors XRandR says nothing about. */
+void
+updaterefresh(void)
+{
+    int i, j;
+    double hz, vtotal;
+    Monitor *m;
+    XRRScreenResources *res;
+    XRRCrtcInfo *ci;
+    XRRModeInfo *mi;
+
+    for (m = mons; m; m = m->next)
+        m->frametime = 0;
+    if (randr && (res = XRRGetScreenResourcesCurrent(dpy, root))) {
+        for (i = 0; i < res->ncrtc; i++) {
+            if (!(ci = XRRGetCrtcInfo(dpy, res, res->crtcs[i])))
+                continue;
+            for (j = 0; j < res->nmode && res->modes[j].id != ci->mode; j++);
+            mi = &res->modes[j];
+            if (ci->mode != None && j < res->nmode && mi->hTotal && mi->vTotal) {
+                vtotal = mi->vTotal;
+                if (mi->modeFlags & RR_DoubleScan)
+                    vtotal *= 2;
+                if (mi->modeFlags & RR_Interlace)
+                    vtotal /= 2;
+                hz = mi->dotClock / (mi->hTotal * vtotal);
+                for (m = mons; m; m = m->next)
+                    if (INTERSECT(ci->x, ci->y, (int)ci->width, (int)ci->height, m) > 0
+                    && (!m->frametime || 1e9 / hz < m->frametime))
+                        m->frametime = 1e9 / hz;
+            }
+            XRRFreeCrtcInfo(ci);
+        }
+        XRRFreeScreenResources(res);
+    }
+    for (m = mons; m; m = m->next)
+        if (!m->frametime)
+            m->frametime = 1000000000ULL / 60;
+}
+
 void
 updatesizehints(Client *c)
 {
@@ -4334,6 +5662,44 @@ updatesystrayiconstate(Client *i, XPropertyEvent *ev)
             systray->win, XEMBED_EMBEDDED_VERSION);
 }
 
+/* Sets up an alarm on the counter of a client listing _NET_WM_SYNC_REQUEST
+ * in WM_PROTOCOLS. The properties are read even without the XSync
+ * extension, so recordings replay the same queries. */
+void
+updatesync(Client *c)
+{
+    Atom *protocols, type;
+    int n, format, listed = 0;
+    unsigned long nitems, after;
+    unsigned char *p = NULL;
+    XSyncCounter counter = None;
+    XSyncValue v;
+    XSyncAlarmAttributes aa;
+
+    if (XGetWMProtocols(dpy, c->win, &protocols, &n)) {
+        while (!listed && n--)
+            listed = protocols[n] == netatom[NetWMSyncRequest];
+        XFree(protocols);
+    }
+    if (listed && XGetWindowProperty(dpy, c->win, netatom[NetWMSyncRequestCounter], 0L, 1L,
+        False, XA_CARDINAL, &type, &format, &nitems, &after, &p) == Success && p) {
+        if (nitems && format == 32)
+            counter = *(long *)p;
+        XFree(p);
+    }
+    if (!usesync || !counter || !XSyncQueryCounter(dpy, counter, &v))
+        return;
+    c->syncvalue = (unsigned long long)XSyncValueHigh32(v) << 32 | XSyncValueLow32(v);
+    aa.trigger.counter = counter;
+    aa.trigger.value_type = XSyncAbsolute;
+    aa.trigger.wait_value = v;
+    aa.trigger.test_type = XSyncPositiveComparison;
+    XSyncIntToValue(&aa.delta, 0);
+    aa.events = True;
+    c->syncalarm = XSyncCreateAlarm(dpy, XSyncCACounter|XSyncCAValueType|XSyncCAValue
+        |XSyncCATestType|XSyncCADelta|XSyncCAEvents, &aa);
+}
+
 void
 updatesystray(void)
 {
@@ -4526,6 +5892,20 @@ view(const Arg *arg)
     }
 }
 
+/* waits for X input until deadline on the prof_now clock, 0 if it passed */
+int
+waitevent(unsigned long long deadline)
+{
+    struct pollfd pfd = { ConnectionNumber(dpy), POLLIN, 0 };
+    unsigned long long t;
+    int r;
+
+    while ((t = prof_now()) < deadline)
+        if ((r = poll(&pfd, 1, (deadline - t + 999999) / 1000000)) != -1)
+            return r;
+    return 0;
+}
+
 void
 warp(const Client *c)
 {
@@ -4533,19 +5913,31 @@ warp(const Client *c)
 
     if (!c) {
         XWarpPointer(dpy, None, root, 0, 0, 0, 0, selmon->wx + selmon->ww/2, selmon->wy + selmon->wh/2);
+        ptr.lost = 1;
         return;
     }
 
-    if (!getrootptr(&x, &y) ||
-        (x > c->x - c->bw &&
-         y > c->y - c->bw &&
-         x < c->x + c->w + c->bw*2 &&
-         y < c->y + c->h + c->bw*2) ||
-        (y > c->mon->by && y < c->mon->by + bh) ||
-        (c->mon->topbar && !y))
+    /* crossing events say what the pointer is over, the position is only
+     * needed while it is over the root window */
+    if (ptr.lost && !syncpointer())
         return;
+    if (ptr.win == c->win || ptr.win == c->mon->barwin || ptr.win == c->mon->tabwin
+    || (showsystray && systray && ptr.win == systray->win)
+    || (!ptr.win && (!getrootptr(&x, &y) || (c->mon->topbar && !y))))
+        return;
+
+    warppointer(c, c->w / 2, c->h / 2);
+}
 
-    XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w / 2, c->h / 2);
+/* warps to x, y inside c and tracks the pointer there without asking */
+void
+warppointer(const Client *c, int x, int y)
+{
+    XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, x, y);
+    ptr.x = c->x + c->bw + x;
+    ptr.y = c->y + c->bw + y;
+    ptr.win = c->win;
+    ptr.moved = ptr.lost = 0;
 }
 
 pid_t
@@ -4554,6 +5946,7 @@ winpid(Window w)
 
     pid_t result = 0;
 
+    TRACEBEGIN("winpid");
 #ifdef __linux__
     xcb_res_client_id_spec_t spec = {0};
     spec.client = w;
@@ -4561,10 +5954,12 @@ winpid(Window w)
 
     xcb_generic_error_t *e = NULL;
     xcb_res_query_client_ids_cookie_t c = xcb_res_query_client_ids(xcon, 1, &spec);
-    xcb_res_query_client_ids_reply_t *r = xcb_res_query_client_ids_reply(xcon, c, &e);
+    xcb_res_query_client_ids_reply_t *r = ROUNDTRIP(xcb_res_query_client_ids_reply(xcon, c, &e));
 
-    if (!r)
+    if (!r) {
+        TRACEEND("winpid");
         return (pid_t)0;
+    }
 
     xcb_res_client_id_value_iterator_t i = xcb_res_query_client_ids_ids_iterator(r);
     for (; i.rem; xcb_res_client_id_value_next(&i)) {
@@ -4590,14 +5985,17 @@ winpid(Window w)
         unsigned char *prop;
         pid_t ret;
 
-        if (XGetWindowProperty(dpy, w, XInternAtom(dpy, "_NET_WM_PID", 0), 0, 1, False, AnyPropertyType, &type, &format, &len, &bytes, &prop) != Success || !prop)
+        if (XGetWindowProperty(dpy, w, XInternAtom(dpy, "_NET_WM_PID", 0), 0, 1, False, AnyPropertyType, &type, &format, &len, &bytes, &prop) != Success || !prop) {
+               TRACEEND("winpid");
                return 0;
+        }
 
         ret = *(pid_t*)prop;
         XFree(prop);
         result = ret;
 
 #endif /* __OpenBSD__ */
+    TRACEEND("winpid");
     return result;
 }
 
@@ -4790,6 +6188,13 @@ xerrordummy(Display *dpy, XErrorEvent *ee)
 
 /* Startup Error handler to check if another window manager
  * is already running. */
+int
+xerrorshm(Display *dpy, XErrorEvent *ee)
+{
+    shmfailed = 1;
+    return 0;
+}
+
 int
 xerrorstart(Display *dpy, XErrorEvent *ee)
 {
@@ -4797,6 +6202,63 @@ xerrorstart(Display *dpy, XErrorEvent *ee)
     return -1;
 }
 
+/* Stops waiting for c to draw, because it has or because it took too long,
+ * and sends what resizeclient held back meanwhile. After a timeout that
+ * goes out without another sync request. */
+void
+syncdone(Client *c, int drawn)
+{
+    c->syncwait = 0;
+    syncwaits--;
+    if (c->syncpending) {
+        c->syncpending = 0;
+        /* a hidden client gets its geometry when showhide brings it back */
+        if (ISVISIBLE(c))
+            configuresync(c, &c->syncwc, drawn);
+        else
+            c->needresize = 1;
+    }
+}
+
+/* Forgets the sync request c is waiting on, and what was held back for it. */
+void
+syncdrop(Client *c)
+{
+    if (c->syncwait)
+        syncwaits--;
+    c->syncwait = c->syncpending = 0;
+}
+
+void
+syncnotify(XEvent *e)
+{
+    XSyncAlarmNotifyEvent *ev = (XSyncAlarmNotifyEvent *)e;
+    Monitor *m;
+    Client *c;
+
+    for (m = mons; m; m = m->next)
+        for (c = m->clients; c; c = c->next)
+            if (c->syncalarm == ev->alarm) {
+                if (c->syncwait)
+                    syncdone(c, 1);
+                return;
+            }
+}
+
+/* asks the server where the pointer is, for when the events seen do not tell */
+int
+syncpointer(void)
+{
+    int di;
+    unsigned int dui;
+    Window dummy;
+
+    ptr.lost = !XQueryPointer(dpy, root, &dummy, &ptr.win, &ptr.x, &ptr.y, &di, &di, &dui);
+    /* the answer is only good for now when motion in clients goes unseen */
+    ptr.moved = !ptr.lost && !xiopcode && ptr.win && wintoclient(ptr.win);
+    return !ptr.lost;
+}
+
 Monitor *
 systraytomon(Monitor *m) {
     Monitor *t;
@@ -4859,8 +6321,8 @@ main(int argc, char *argv[])
 {
     if (argc == 2 && !strcmp("-v", argv[1]))
         die("dwm-"VERSION);
-    else if (argc != 1 && strcmp("-s", argv[1]))
-        die("usage: dwm [-v]");
+    else if (argc != 1 && strcmp("-s", argv[1]) && (argc != 3 || strcmp("-r", argv[1])))
+        die("usage: dwm [-v] [-r file]");
     if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
         fputs("warning: no locale support\n", stderr);
     if (!(dpy = XOpenDisplay(NULL)))
@@ -4873,6 +6335,8 @@ main(int argc, char *argv[])
         return 0;
     }
     checkotherwm();
+    if (argc == 3 && !strcmp("-r", argv[1]) && !rec_open(argv[2], dpy))
+        die("dwm: cannot record to '%s':", argv[2]);
     setup();
 #ifdef __OpenBSD__
     if (pledge("stdio rpath proc exec ps", NULL) == -1)
@@ -4880,6 +6344,7 @@ main(int argc, char *argv[])
 #endif /* __OpenBSD__ */
     scan();
     run();
+    rec_close();
     if (restart)
         execvp(argv[0], argv);
     cleanup();
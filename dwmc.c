@@ -31,5 +31,5 @@ toggletagex(const Arg *arg)
 void
 setlayoutex(const Arg *arg)
 {
-    setlayout(&((Arg) { .v = &layouts[arg->i] }));
+    setlayout(&((Arg) { .i = arg->i }));
 }
@@ -0,0 +1,113 @@
+/* See LICENSE file for copyright and license details. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "preview.h"
+#include "util.h"
+
+/* column sums of the source rows that make up one output row */
+static uint16_t *acc;
+static size_t accsize;
+
+/* acc[i] += src[i] for n bytes, the vector width is picked at build time */
+static void
+addrow(uint16_t *a, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 16 <= n; i += 16) {
+        __m256i s = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + i)));
+
+        _mm256_storeu_si256((__m256i *)(a + i),
+            _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)(a + i)), s));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+
+        _mm_storeu_si128((__m128i *)(a + i),
+            _mm_add_epi16(_mm_loadu_si128((const __m128i *)(a + i)), _mm_unpacklo_epi8(s, zero)));
+        _mm_storeu_si128((__m128i *)(a + i + 8),
+            _mm_add_epi16(_mm_loadu_si128((const __m128i *)(a + i + 8)), _mm_unpackhi_epi8(s, zero)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+
+        vst1q_u16(a + i, vaddw_u8(vld1q_u16(a + i), vget_low_u8(s)));
+        vst1q_u16(a + i + 8, vaddw_u8(vld1q_u16(a + i + 8), vget_high_u8(s)));
+    }
+#endif
+    for (; i < n; i++)
+        a[i] += src[i];
+}
+
+/* Averages every f×f block of the w×h source into one pixel of dst, each
+ * byte on its own so the channel order does not matter. w and h must be
+ * multiples of f and f at most BOX_MAXF. The vertical sums, which touch
+ * every source byte, are vectorised; the horizontal pass runs on 1/f of
+ * the data. */
+void
+box_downscale(unsigned char *dst, size_t dstride, const unsigned char *src, size_t sstride,
+              int w, int h, int f)
+{
+    size_t n = (size_t)w * 4;
+    uint32_t sum, r = (1 << 24) / (f * f);
+    uint8_t *d;
+    int x, y, k, c;
+
+    if (accsize < n) {
+        free(acc);
+        acc = ecalloc(n, sizeof(uint16_t));
+        accsize = n;
+    }
+    for (y = 0; y < h / f; y++) {
+        memset(acc, 0, n * sizeof(uint16_t));
+        for (k = 0; k < f; k++)
+            addrow(acc, src + (size_t)(y * f + k) * sstride, n);
+        d = dst + (size_t)y * dstride;
+        for (x = 0; x < w / f; x++)
+            for (c = 0; c < 4; c++) {
+                for (sum = 0, k = 0; k < f; k++)
+                    sum += acc[(x * f + k) * 4 + c];
+                *d++ = (sum * r + (1 << 23)) >> 24;
+            }
+    }
+}
+
+void
+rgb565_pack(unsigned short *dst, const unsigned char *src, size_t sstride, int w, int h)
+{
+    const uint32_t *p;
+    int x, y;
+
+    for (y = 0; y < h; y++)
+        for (p = (const uint32_t *)(src + (size_t)y * sstride), x = 0; x < w; x++, p++)
+            *dst++ = (*p >> 8 & 0xf800) | (*p >> 5 & 0x07e0) | (*p >> 3 & 0x001f);
+}
+
+void
+rgb565_unpack(unsigned char *dst, size_t dstride, const unsigned short *src, int w, int h)
+{
+    uint32_t *p, r, g, b;
+    int x, y;
+
+    for (y = 0; y < h; y++)
+        for (p = (uint32_t *)(dst + (size_t)y * dstride), x = 0; x < w; x++, src++) {
+            r = *src >> 11;
+            g = *src >> 5 & 0x3f;
+            b = *src & 0x1f;
+            *p++ = (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2);
+        }
+}
@@ -0,0 +1,11 @@
+/* See LICENSE file for copyright and license details. */
+
+#define BOX_MAXF                16 /* largest factor whose sums fit 16 bits */
+
+/* Downscaling of 32 bit pixels for tag previews */
+void box_downscale(unsigned char *dst, size_t dstride, const unsigned char *src, size_t sstride,
+                   int w, int h, int f);
+
+/* Cold previews, 0x00RRGGBB pixels in native byte order */
+void rgb565_pack(unsigned short *dst, const unsigned char *src, size_t sstride, int w, int h);
+void rgb565_unpack(unsigned char *dst, size_t dstride, const unsigned short *src, int w, int h);
@@ -0,0 +1,137 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prof.h"
+
+typedef struct {
+    const char *name;
+    unsigned long long ts; /* ns */
+    char ph;
+} TraceEvent;
+
+int tracing = 0;
+unsigned long roundtrips = 0;
+unsigned long xftextents = 0, fontloads = 0;
+
+/* written only from the event loop, so a free-running head index is all
+ * the synchronisation the ring needs; old events are overwritten */
+static TraceEvent ring[TRACE_SIZE];
+static unsigned long head = 0;
+
+unsigned long long
+prof_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+hist_add(Hist *h, unsigned long long ns)
+{
+    unsigned int i;
+
+    for (i = 0; i < PROF_BUCKETS - 1 && ns >> (i + 1); i++);
+    h->buckets[i]++;
+    h->count++;
+    h->total += ns;
+    if (ns > h->max)
+        h->max = ns;
+}
+
+void
+hist_addx(Hist *h, unsigned long reqs, unsigned long rtrips)
+{
+    h->reqs += reqs;
+    h->rtrips += rtrips;
+    if (reqs > h->maxreqs)
+        h->maxreqs = reqs;
+    if (rtrips > h->maxrtrips)
+        h->maxrtrips = rtrips;
+}
+
+/* upper bound of the bucket holding the p-th percentile sample */
+static unsigned long long
+hist_pct(const Hist *h, unsigned int p)
+{
+    unsigned long seen = 0, want;
+    unsigned int i;
+
+    want = (h->count * p + 99) / 100;
+    for (i = 0; i < PROF_BUCKETS; i++)
+        if ((seen += h->buckets[i]) >= want)
+            break;
+    return i < PROF_BUCKETS - 1 && (2ULL << i) < h->max ? (2ULL << i) : h->max;
+}
+
+void
+hist_dump(FILE *f, const char *title, const Hist *h, size_t n, int json)
+{
+    size_t i, j, first = 1;
+
+    if (json)
+        fprintf(f, "\"%s\":[", title);
+    else
+        fprintf(f, "%-20s %10s %10s %10s %10s %10s %8s %8s %8s %8s\n", title,
+            "count", "mean(us)", "p50(us)", "p99(us)", "max(us)",
+            "req/call", "maxreq", "rt/call", "maxrt");
+    for (i = 0; i < n; i++) {
+        if (!h[i].count || !h[i].name)
+            continue;
+        if (!json) {
+            fprintf(f, "%-20s %10lu %10.1f %10.1f %10.1f %10.1f %8.1f %8lu %8.1f %8lu\n",
+                h[i].name, h[i].count, h[i].total / 1e3 / h[i].count,
+                hist_pct(&h[i], 50) / 1e3, hist_pct(&h[i], 99) / 1e3, h[i].max / 1e3,
+                (double)h[i].reqs / h[i].count, h[i].maxreqs,
+                (double)h[i].rtrips / h[i].count, h[i].maxrtrips);
+            continue;
+        }
+        fprintf(f, "%s{\"name\":\"%s\",\"count\":%lu,\"total_ns\":%llu,\"max_ns\":%llu,"
+            "\"requests\":%llu,\"max_requests\":%lu,\"roundtrips\":%llu,\"max_roundtrips\":%lu,"
+            "\"log2_ns_buckets\":[",
+            first ? "" : ",", h[i].name, h[i].count, h[i].total, h[i].max,
+            h[i].reqs, h[i].maxreqs, h[i].rtrips, h[i].maxrtrips);
+        for (j = 0; j < PROF_BUCKETS; j++)
+            fprintf(f, "%s%lu", j ? "," : "", h[i].buckets[j]);
+        fputs("]}", f);
+        first = 0;
+    }
+    if (json)
+        fputs("]", f);
+}
+
+void
+trace_event(const char *name, char ph)
+{
+    TraceEvent *e = &ring[head++ & (TRACE_SIZE - 1)];
+
+    e->name = name;
+    e->ph = ph;
+    e->ts = prof_now();
+}
+
+/* writes the ring in Chrome trace event format, loadable in
+ * chrome://tracing or ui.perfetto.dev */
+int
+trace_dump(const char *path)
+{
+    FILE *f;
+    unsigned long i, first;
+    const TraceEvent *e;
+    int pid = getpid();
+
+    if (!(f = fopen(path, "w")))
+        return 0;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+    first = head > TRACE_SIZE ? head - TRACE_SIZE : 0;
+    for (i = first; i < head; i++) {
+        e = &ring[i & (TRACE_SIZE - 1)];
+        fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d}",
+            i == first ? "" : ",", e->name, e->ph, e->ts / 1000, e->ts % 1000, pid, pid);
+    }
+    fputs("]}\n", f);
+    return fclose(f) == 0;
+}
@@ -0,0 +1,39 @@
+/* See LICENSE file for copyright and license details. */
+
+#define PROF_BUCKETS 40 /* bucket i holds samples in [2^i, 2^(i+1)) ns */
+#define TRACE_SIZE   (1 << 16) /* trace ring capacity in events, power of two */
+
+#define TRACEBEGIN(N)           (tracing ? trace_event((N), 'B') : (void)0)
+#define TRACEEND(N)             (tracing ? trace_event((N), 'E') : (void)0)
+#define ROUNDTRIP(CALL)         (roundtrips++, (CALL))
+
+/* blocking Xlib calls are counted as round trips, the ones with replies by
+ * the recorder (record.h); a macro does not expand inside its own
+ * replacement, so this still calls the real function */
+#define XSync(...)              ROUNDTRIP(XSync(__VA_ARGS__))
+
+typedef struct {
+    const char *name;
+    unsigned long count;
+    unsigned long long total, max; /* ns */
+    unsigned long buckets[PROF_BUCKETS];
+    unsigned long long reqs, rtrips; /* X requests and round trips */
+    unsigned long maxreqs, maxrtrips;
+} Hist;
+
+/* Clock */
+unsigned long long prof_now(void);
+
+/* Histograms */
+void hist_add(Hist *h, unsigned long long ns);
+void hist_addx(Hist *h, unsigned long reqs, unsigned long rtrips);
+void hist_dump(FILE *f, const char *title, const Hist *h, size_t n, int json);
+
+/* X accounting */
+extern unsigned long roundtrips;
+extern unsigned long xftextents, fontloads; /* text measurements, fallback fonts opened */
+
+/* Trace recorder, names must outlive the recording */
+extern int tracing;
+void trace_event(const char *name, char ph);
+int trace_dump(const char *path);
@@ -0,0 +1,648 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Event recorder. With dwm -r every event dwm reads, every reply to its
+ * blocking queries and every check for queued events is appended to a binary stream of records, each a
+ * header followed by its payload. Replaying the stream through handler[]
+ * against a display layer that answers from it (bench/xstub.c) repeats a
+ * session without an X server, as long as dwm asks the same questions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/XInput2.h>
+#ifdef XINERAMA
+#include <X11/extensions/Xinerama.h>
+#endif /* XINERAMA */
+
+#define RECORDER
+#include "prof.h"
+#include "record.h"
+#include "util.h"
+
+typedef struct {
+    unsigned int kind, len; /* len bytes of payload follow */
+    long status;
+} RecHeader;
+
+FILE *recfile = NULL;
+static FILE *replayfile = NULL;
+static unsigned char *buf = NULL;
+static size_t buflen = 0, bufsize = 0, bufpos = 0;
+static unsigned long nrecords = 0;
+
+static void
+put(const void *p, size_t n)
+{
+    if (buflen + n > bufsize) {
+        bufsize = MAX(bufsize * 2, buflen + n);
+        if (!(buf = realloc(buf, bufsize)))
+            die("realloc:");
+    }
+    memcpy(buf + buflen, p, n);
+    buflen += n;
+}
+
+static void
+putstr(const char *s)
+{
+    put(s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+static void
+end(unsigned int kind, long status)
+{
+    RecHeader h = { kind, buflen, status };
+
+    fwrite(&h, sizeof h, 1, recfile);
+    fwrite(buf, 1, buflen, recfile);
+    buflen = 0;
+}
+
+/* events are mostly zeros past their own struct */
+static void
+putevent(const XEvent *ev)
+{
+    size_t n = sizeof *ev;
+
+    while (n && !((const unsigned char *)ev)[n - 1])
+        n--;
+    put(ev, n);
+}
+
+int
+rec_open(const char *path, Display *dpy)
+{
+    long screen[6];
+    int s;
+
+    if (!dpy)
+        return (replayfile = fopen(path, "rb")) != NULL;
+    if (!(recfile = fopen(path, "wb")))
+        return 0;
+    s = DefaultScreen(dpy);
+    screen[0] = RootWindow(dpy, s);
+    screen[1] = DisplayWidth(dpy, s);
+    screen[2] = DisplayHeight(dpy, s);
+    screen[3] = DisplayWidthMM(dpy, s);
+    screen[4] = DisplayHeightMM(dpy, s);
+    screen[5] = DefaultDepth(dpy, s);
+    put(screen, sizeof screen);
+    end(RecDisplay, s);
+    return 1;
+}
+
+void
+rec_close(void)
+{
+    if (recfile)
+        fclose(recfile);
+    if (replayfile)
+        fclose(replayfile);
+    recfile = replayfile = NULL;
+}
+
+/* returns 0 at the end of the recording */
+int
+rec_next(int kind, long *status)
+{
+    RecHeader h;
+
+    if (!replayfile || fread(&h, sizeof h, 1, replayfile) != 1)
+        return 0;
+    if (h.kind != kind)
+        die("replay: record %lu is of kind %u, dwm asked for %d", nrecords, h.kind, kind);
+    if (h.len > bufsize) {
+        free(buf);
+        buf = ecalloc(bufsize = h.len, 1);
+    }
+    if (fread(buf, 1, h.len, replayfile) != h.len)
+        die("replay: record %lu is truncated", nrecords);
+    nrecords++;
+    buflen = h.len;
+    bufpos = 0;
+    *status = h.status;
+    return 1;
+}
+
+void
+rec_get(void *p, size_t n)
+{
+    if (bufpos + n > buflen)
+        die("replay: record %lu is shorter than its reply", nrecords);
+    memcpy(p, buf + bufpos, n);
+    bufpos += n;
+}
+
+/* Xlib allocated replies are released with XFree, which is free there */
+void *
+rec_getalloc(size_t n)
+{
+    void *p = ecalloc(n + 1, 1);
+
+    rec_get(p, n);
+    return p;
+}
+
+char *
+rec_getstr(void)
+{
+    size_t n = strnlen((char *)buf + bufpos, buflen - bufpos);
+
+    if (bufpos + n >= buflen)
+        die("replay: record %lu is shorter than its reply", nrecords);
+    return rec_getalloc(n + 1);
+}
+
+void
+rec_getevent(Display *dpy, XEvent *ev)
+{
+    memset(ev, 0, sizeof *ev);
+    rec_get(ev, MIN(buflen - bufpos, sizeof *ev));
+    ev->xany.display = dpy;
+}
+
+int
+rec_nextevent(Display *dpy, XEvent *ev)
+{
+    int r = XNextEvent(dpy, ev);
+
+    if (recfile) {
+        putevent(ev);
+        end(RecEvent, r);
+    }
+    return r;
+}
+
+int
+rec_peekevent(Display *dpy, XEvent *ev)
+{
+    int r = XPeekEvent(dpy, ev);
+
+    if (recfile) {
+        putevent(ev);
+        end(RecEvent, r);
+    }
+    return r;
+}
+
+/* what dwm does while idle depends on it, so it is kept like a reply */
+int
+rec_pending(Display *dpy)
+{
+    int r = XPending(dpy);
+
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+int
+rec_maskevent(Display *dpy, long mask, XEvent *ev)
+{
+    int r = XMaskEvent(dpy, mask, ev);
+
+    if (recfile) {
+        putevent(ev);
+        end(RecEvent, r);
+    }
+    return r;
+}
+
+Bool
+rec_checkmaskevent(Display *dpy, long mask, XEvent *ev)
+{
+    Bool r = XCheckMaskEvent(dpy, mask, ev);
+
+    if (recfile) {
+        if (r)
+            putevent(ev);
+        end(RecEvent, r);
+    }
+    return r;
+}
+
+Window
+rec_createsimplewindow(Display *dpy, Window parent, int x, int y, unsigned int w,
+    unsigned int h, unsigned int bw, unsigned long border, unsigned long bg)
+{
+    Window r = XCreateSimpleWindow(dpy, parent, x, y, w, h, bw, border, bg);
+
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+Window
+rec_createwindow(Display *dpy, Window parent, int x, int y, unsigned int w, unsigned int h,
+    unsigned int bw, int depth, unsigned int class, Visual *visual, unsigned long mask,
+    XSetWindowAttributes *wa)
+{
+    Window r = XCreateWindow(dpy, parent, x, y, w, h, bw, depth, class, visual, mask, wa);
+
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+Status
+rec_getclasshint(Display *dpy, Window w, XClassHint *ch)
+{
+    Status r;
+
+    roundtrips++;
+    r = XGetClassHint(dpy, w, ch);
+    if (recfile) {
+        if (r) {
+            putstr(ch->res_name);
+            putstr(ch->res_class);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+int
+rec_getinputfocus(Display *dpy, Window *focus, int *revert)
+{
+    int r;
+
+    roundtrips++;
+    r = XGetInputFocus(dpy, focus, revert);
+    if (recfile) {
+        put(focus, sizeof *focus);
+        put(revert, sizeof *revert);
+        end(RecReply, r);
+    }
+    return r;
+}
+
+KeySym *
+rec_getkeyboardmapping(Display *dpy, unsigned int first, int count, int *per)
+{
+    KeySym *r;
+
+    roundtrips++;
+    r = XGetKeyboardMapping(dpy, first, count, per);
+    if (recfile) {
+        if (r) {
+            put(per, sizeof *per);
+            put(r, count * *per * sizeof *r);
+        }
+        end(RecReply, r != NULL);
+    }
+    return r;
+}
+
+XModifierKeymap *
+rec_getmodifiermapping(Display *dpy)
+{
+    XModifierKeymap *r;
+
+    roundtrips++;
+    r = XGetModifierMapping(dpy);
+    if (recfile) {
+        if (r) {
+            put(&r->max_keypermod, sizeof r->max_keypermod);
+            put(r->modifiermap, 8 * r->max_keypermod);
+        }
+        end(RecReply, r != NULL);
+    }
+    return r;
+}
+
+Window
+rec_getselectionowner(Display *dpy, Atom selection)
+{
+    Window r;
+
+    roundtrips++;
+    r = XGetSelectionOwner(dpy, selection);
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+Status
+rec_gettextprop(Display *dpy, Window w, XTextProperty *tp, Atom atom)
+{
+    Status r;
+
+    roundtrips++;
+    r = XGetTextProperty(dpy, w, tp, atom);
+    if (recfile) {
+        if (r) {
+            put(&tp->encoding, sizeof tp->encoding);
+            put(&tp->format, sizeof tp->format);
+            put(&tp->nitems, sizeof tp->nitems);
+            put(tp->value, tp->nitems * tp->format / 8);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+Status
+rec_gettransientforhint(Display *dpy, Window w, Window *trans)
+{
+    Status r;
+
+    roundtrips++;
+    r = XGetTransientForHint(dpy, w, trans);
+    if (recfile) {
+        put(trans, sizeof *trans);
+        end(RecReply, r);
+    }
+    return r;
+}
+
+Status
+rec_getwindowattributes(Display *dpy, Window w, XWindowAttributes *wa)
+{
+    Status r;
+
+    roundtrips++;
+    r = XGetWindowAttributes(dpy, w, wa);
+    if (recfile) {
+        if (r)
+            put(wa, sizeof *wa);
+        end(RecReply, r);
+    }
+    return r;
+}
+
+int
+rec_getwindowproperty(Display *dpy, Window w, Atom prop, long off, long len, Bool del,
+    Atom req, Atom *type, int *format, unsigned long *n, unsigned long *after, unsigned char **p)
+{
+    int r;
+
+    roundtrips++;
+    r = XGetWindowProperty(dpy, w, prop, off, len, del, req, type, format, n, after, p);
+    if (recfile) {
+        if (r == Success) {
+            put(type, sizeof *type);
+            put(format, sizeof *format);
+            put(n, sizeof *n);
+            put(after, sizeof *after);
+            if (*p) /* format 32 is returned in longs */
+                put(*p, *n * (*format == 32 ? sizeof(long) : *format / 8));
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+XWMHints *
+rec_getwmhints(Display *dpy, Window w)
+{
+    XWMHints *r;
+
+    roundtrips++;
+    r = XGetWMHints(dpy, w);
+    if (recfile) {
+        if (r)
+            put(r, sizeof *r);
+        end(RecReply, r != NULL);
+    }
+    return r;
+}
+
+Status
+rec_getwmnormalhints(Display *dpy, Window w, XSizeHints *hints, long *supplied)
+{
+    Status r;
+
+    roundtrips++;
+    r = XGetWMNormalHints(dpy, w, hints, supplied);
+    if (recfile) {
+        if (r) {
+            put(hints, sizeof *hints);
+            put(supplied, sizeof *supplied);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+Status
+rec_getwmprotocols(Display *dpy, Window w, Atom **protocols, int *n)
+{
+    Status r;
+
+    roundtrips++;
+    r = XGetWMProtocols(dpy, w, protocols, n);
+    if (recfile) {
+        if (r) {
+            put(n, sizeof *n);
+            put(*protocols, *n * sizeof **protocols);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+int
+rec_grabpointer(Display *dpy, Window w, Bool owner, unsigned int mask, int pmode, int kmode,
+    Window confine, Cursor cursor, Time time)
+{
+    int r;
+
+    roundtrips++;
+    r = XGrabPointer(dpy, w, owner, mask, pmode, kmode, confine, cursor, time);
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+Atom
+rec_internatom(Display *dpy, const char *name, Bool exists)
+{
+    Atom r;
+
+    roundtrips++;
+    r = XInternAtom(dpy, name, exists);
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+/* answered from the keyboard mapping Xlib caches, not round trips */
+KeySym
+rec_keycodetokeysym(Display *dpy, unsigned int code, int index)
+{
+    KeySym r = XKeycodeToKeysym(dpy, code, index);
+
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+KeyCode
+rec_keysymtokeycode(Display *dpy, KeySym sym)
+{
+    KeyCode r = XKeysymToKeycode(dpy, sym);
+
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+Bool
+rec_querypointer(Display *dpy, Window w, Window *root, Window *child, int *rx, int *ry,
+    int *x, int *y, unsigned int *mask)
+{
+    Bool r;
+
+    roundtrips++;
+    r = XQueryPointer(dpy, w, root, child, rx, ry, x, y, mask);
+    if (recfile) {
+        put(root, sizeof *root);
+        put(child, sizeof *child);
+        put(rx, sizeof *rx);
+        put(ry, sizeof *ry);
+        put(x, sizeof *x);
+        put(y, sizeof *y);
+        put(mask, sizeof *mask);
+        end(RecReply, r);
+    }
+    return r;
+}
+
+Status
+rec_querytree(Display *dpy, Window w, Window *root, Window *parent, Window **children,
+    unsigned int *n)
+{
+    Status r;
+
+    roundtrips++;
+    r = XQueryTree(dpy, w, root, parent, children, n);
+    if (recfile) {
+        if (r) {
+            put(root, sizeof *root);
+            put(parent, sizeof *parent);
+            put(n, sizeof *n);
+            put(*children, *n * sizeof **children);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+Bool
+rec_queryextension(Display *dpy, const char *name, int *opcode, int *event, int *error)
+{
+    Bool r;
+
+    roundtrips++;
+    r = XQueryExtension(dpy, name, opcode, event, error);
+    if (recfile) {
+        if (r) {
+            put(opcode, sizeof *opcode);
+            put(event, sizeof *event);
+            put(error, sizeof *error);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+Bool
+rec_rrqueryextension(Display *dpy, int *event, int *error)
+{
+    Bool r;
+
+    roundtrips++;
+    r = XRRQueryExtension(dpy, event, error);
+    if (recfile) {
+        if (r) {
+            put(event, sizeof *event);
+            put(error, sizeof *error);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+Status
+rec_rrqueryversion(Display *dpy, int *major, int *minor)
+{
+    Status r;
+
+    roundtrips++;
+    r = XRRQueryVersion(dpy, major, minor);
+    if (recfile) {
+        if (r) {
+            put(major, sizeof *major);
+            put(minor, sizeof *minor);
+        }
+        end(RecReply, r);
+    }
+    return r;
+}
+
+/* the outputs of each monitor are not kept */
+XRRMonitorInfo *
+rec_rrgetmonitors(Display *dpy, Window w, Bool active, int *n)
+{
+    XRRMonitorInfo *r;
+
+    roundtrips++;
+    r = XRRGetMonitors(dpy, w, active, n);
+    if (recfile) {
+        if (r) {
+            put(n, sizeof *n);
+            put(r, *n * sizeof *r);
+        }
+        end(RecReply, r != NULL);
+    }
+    return r;
+}
+
+Status
+rec_xiqueryversion(Display *dpy, int *major, int *minor)
+{
+    Status r;
+
+    roundtrips++;
+    r = XIQueryVersion(dpy, major, minor);
+    if (recfile) {
+        put(major, sizeof *major);
+        put(minor, sizeof *minor);
+        end(RecReply, r);
+    }
+    return r;
+}
+
+#ifdef XINERAMA
+Bool
+rec_xineramaisactive(Display *dpy)
+{
+    Bool r;
+
+    roundtrips++;
+    r = XineramaIsActive(dpy);
+    if (recfile)
+        end(RecReply, r);
+    return r;
+}
+
+XineramaScreenInfo *
+rec_xineramaqueryscreens(Display *dpy, int *n)
+{
+    XineramaScreenInfo *r;
+
+    roundtrips++;
+    r = XineramaQueryScreens(dpy, n);
+    if (recfile) {
+        if (r) {
+            put(n, sizeof *n);
+            put(r, *n * sizeof *r);
+        }
+        end(RecReply, r != NULL);
+    }
+    return r;
+}
+#endif /* XINERAMA */
@@ -0,0 +1,97 @@
+/* See LICENSE file for copyright and license details. */
+
+enum { RecDisplay, RecEvent, RecReply }; /* record kinds */
+
+/* Recorder, a stream of events and query replies */
+extern FILE *recfile;
+int rec_open(const char *path, Display *dpy);
+void rec_close(void);
+
+/* Reader, used by the replay display layer */
+int rec_next(int kind, long *status);
+void rec_get(void *p, size_t n);
+void *rec_getalloc(size_t n);
+char *rec_getstr(void);
+void rec_getevent(Display *dpy, XEvent *ev);
+
+/* Events */
+int rec_nextevent(Display *dpy, XEvent *ev);
+int rec_peekevent(Display *dpy, XEvent *ev);
+int rec_pending(Display *dpy);
+int rec_maskevent(Display *dpy, long mask, XEvent *ev);
+Bool rec_checkmaskevent(Display *dpy, long mask, XEvent *ev);
+
+/* Queries, the blocking ones are counted as round trips */
+Window rec_createsimplewindow(Display *dpy, Window parent, int x, int y, unsigned int w,
+    unsigned int h, unsigned int bw, unsigned long border, unsigned long bg);
+Window rec_createwindow(Display *dpy, Window parent, int x, int y, unsigned int w, unsigned int h,
+    unsigned int bw, int depth, unsigned int class, Visual *visual, unsigned long mask,
+    XSetWindowAttributes *wa);
+Status rec_getclasshint(Display *dpy, Window w, XClassHint *ch);
+int rec_getinputfocus(Display *dpy, Window *focus, int *revert);
+KeySym *rec_getkeyboardmapping(Display *dpy, unsigned int first, int count, int *per);
+XModifierKeymap *rec_getmodifiermapping(Display *dpy);
+Window rec_getselectionowner(Display *dpy, Atom selection);
+Status rec_gettextprop(Display *dpy, Window w, XTextProperty *tp, Atom atom);
+Status rec_gettransientforhint(Display *dpy, Window w, Window *trans);
+Status rec_getwindowattributes(Display *dpy, Window w, XWindowAttributes *wa);
+int rec_getwindowproperty(Display *dpy, Window w, Atom prop, long off, long len, Bool del,
+    Atom req, Atom *type, int *format, unsigned long *n, unsigned long *after, unsigned char **p);
+XWMHints *rec_getwmhints(Display *dpy, Window w);
+Status rec_getwmnormalhints(Display *dpy, Window w, XSizeHints *hints, long *supplied);
+Status rec_getwmprotocols(Display *dpy, Window w, Atom **protocols, int *n);
+int rec_grabpointer(Display *dpy, Window w, Bool owner, unsigned int mask, int pmode, int kmode,
+    Window confine, Cursor cursor, Time time);
+Atom rec_internatom(Display *dpy, const char *name, Bool exists);
+KeySym rec_keycodetokeysym(Display *dpy, unsigned int code, int index);
+KeyCode rec_keysymtokeycode(Display *dpy, KeySym sym);
+Bool rec_querypointer(Display *dpy, Window w, Window *root, Window *child, int *rx, int *ry,
+    int *x, int *y, unsigned int *mask);
+Status rec_querytree(Display *dpy, Window w, Window *root, Window *parent, Window **children,
+    unsigned int *n);
+Bool rec_queryextension(Display *dpy, const char *name, int *opcode, int *event, int *error);
+Bool rec_rrqueryextension(Display *dpy, int *event, int *error);
+Status rec_rrqueryversion(Display *dpy, int *major, int *minor);
+XRRMonitorInfo *rec_rrgetmonitors(Display *dpy, Window w, Bool active, int *n);
+Status rec_xiqueryversion(Display *dpy, int *major, int *minor);
+#ifdef XINERAMA
+Bool rec_xineramaisactive(Display *dpy);
+XineramaScreenInfo *rec_xineramaqueryscreens(Display *dpy, int *n);
+#endif /* XINERAMA */
+
+/* dwm.c reaches the server through the recorder, record.c calls the real
+ * functions */
+#ifndef RECORDER
+#define XCheckMaskEvent(...)      rec_checkmaskevent(__VA_ARGS__)
+#define XCreateSimpleWindow(...)  rec_createsimplewindow(__VA_ARGS__)
+#define XCreateWindow(...)        rec_createwindow(__VA_ARGS__)
+#define XGetClassHint(...)        rec_getclasshint(__VA_ARGS__)
+#define XGetInputFocus(...)       rec_getinputfocus(__VA_ARGS__)
+#define XGetKeyboardMapping(...)  rec_getkeyboardmapping(__VA_ARGS__)
+#define XGetModifierMapping(...)  rec_getmodifiermapping(__VA_ARGS__)
+#define XGetSelectionOwner(...)   rec_getselectionowner(__VA_ARGS__)
+#define XGetTextProperty(...)     rec_gettextprop(__VA_ARGS__)
+#define XGetTransientForHint(...) rec_gettransientforhint(__VA_ARGS__)
+#define XGetWMHints(...)          rec_getwmhints(__VA_ARGS__)
+#define XGetWMNormalHints(...)    rec_getwmnormalhints(__VA_ARGS__)
+#define XGetWMProtocols(...)      rec_getwmprotocols(__VA_ARGS__)
+#define XGetWindowAttributes(...) rec_getwindowattributes(__VA_ARGS__)
+#define XGetWindowProperty(...)   rec_getwindowproperty(__VA_ARGS__)
+#define XGrabPointer(...)         rec_grabpointer(__VA_ARGS__)
+#define XInternAtom(...)          rec_internatom(__VA_ARGS__)
+#define XKeycodeToKeysym(...)     rec_keycodetokeysym(__VA_ARGS__)
+#define XKeysymToKeycode(...)     rec_keysymtokeycode(__VA_ARGS__)
+#define XMaskEvent(...)           rec_maskevent(__VA_ARGS__)
+#define XNextEvent(...)           rec_nextevent(__VA_ARGS__)
+#define XPeekEvent(...)           rec_peekevent(__VA_ARGS__)
+#define XPending(...)             rec_pending(__VA_ARGS__)
+#define XIQueryVersion(...)       rec_xiqueryversion(__VA_ARGS__)
+#define XQueryExtension(...)      rec_queryextension(__VA_ARGS__)
+#define XQueryPointer(...)        rec_querypointer(__VA_ARGS__)
+#define XQueryTree(...)           rec_querytree(__VA_ARGS__)
+#define XRRGetMonitors(...)       rec_rrgetmonitors(__VA_ARGS__)
+#define XRRQueryExtension(...)    rec_rrqueryextension(__VA_ARGS__)
+#define XRRQueryVersion(...)      rec_rrqueryversion(__VA_ARGS__)
+#define XineramaIsActive(...)     rec_xineramaisactive(__VA_ARGS__)
+#define XineramaQueryScreens(...) rec_xineramaqueryscreens(__VA_ARGS__)
+#endif /* RECORDER */